@@ -1,6 +1,19 @@
 #pragma once
 
+#include <stdint.h>
 #include <string.h>
+#include "arena.h"
+#include "keytable.h"
+
+//Maps with more keys than this build a hash index for lookups
+#ifndef AMAP_INDEX_THRESHOLD
+#define AMAP_INDEX_THRESHOLD 16
+#endif
+
+//How AMap::get_create treats a key it has to insert
+#define AMAP_KEY_COPY 0   // store a copy of the key
+#define AMAP_KEY_BORROW 1 // store the pointer, the key must outlive the map
+#define AMAP_KEY_ADOPT 2  // the key was allocated with alloc_key() on this map
 
 template <class T>
 class AList {
@@ -8,41 +21,66 @@ public:
     int _size = 1;
     int count = 0;
     T *elements;
-    AList(AList<T> &source) { 
-        elements = (T*)malloc(sizeof(T) * source._size);
-#ifdef MALLOC_DEBUG
-        Serial.print("Cloned malloc: ");
-        Serial.println(int(elements));
-#endif
+    //Storage comes from this arena instead of the heap when set
+    Json::Arena *arena;
+    //On running out of memory the copy is left empty with elements NULL
+    AList(AList<T> &source) {
+        arena = NULL;
+        elements = (T*)Json::heapAlloc(sizeof(T) * source._size);
+        if(elements == NULL) {
+            _size = 0;
+            return;
+        }
         memcpy(elements, source.elements, sizeof(T) * source._size);
         _size = source._size;
         count = source.count;
     }
-    AList() {
+    AList(Json::Arena *arena = NULL) {
+        this->arena = arena;
         _size = 1;
         count = 0;
-        elements = (T*)malloc(sizeof(T));
-#ifdef MALLOC_DEBUG
-        Serial.print("Malloc: ");
-        Serial.println(int(elements));
-#endif
+        elements = (T*)Json::allocate(arena, sizeof(T));
+        if(elements == NULL)
+            _size = 0;
     }
     ~AList() {
-#ifdef MALLOC_DEBUG
-        Serial.print("Freeing: ");
-        Serial.println(int(elements));
-#endif
-        free(elements);
+        Json::release(arena, elements, sizeof(T) * _size);
+    }
+    //Lists and the containers built on them come from the library's heap;
+    //a NULL result makes new return NULL instead of throwing
+    static void *operator new(size_t size) throw() {
+        return Json::heapAlloc(size);
+    }
+    static void *operator new(size_t size, void *mem) throw() {
+        return mem;
+    }
+    static void operator delete(void *ptr, size_t size) {
+        Json::heapFree(ptr, size);
     }
-    void append(T value) {
+    static void operator delete(void *ptr, void *mem) { }
+    //Returns false if the list could not grow, leaving it unchanged
+    bool append(const T &value) {
         if(count == _size) {
-            _size *= 2;
-            elements = (T*)realloc(elements, sizeof(T) * _size);
+            //value may live in the block that is about to move
+            if(&value >= elements && &value < elements + count) {
+                T copy = value;
+                return append(copy);
+            }
+            int new_size = _size ? _size * 2 : 1;
+            T *grown = (T*)Json::reallocate(arena, elements, sizeof(T) * _size, sizeof(T) * new_size);
+            if(grown == NULL)
+                return false;
+#ifdef JSON_STATS
+            Json::stats.list_grows++;
+#endif
+            elements = grown;
+            _size = new_size;
         }
         //For some reason assigning to the location causes a hang with T = Result
         //Instead I'll just memcpy I guess
         memcpy(&elements[count], &value, sizeof(T));
         count++;
+        return true;
     }
     T &get(int i) {
         return elements[i];
@@ -61,44 +99,120 @@ private:
 };
 
 
+//Longest key a map accepts; the length is cached in 14 bits
+#define AMAP_MAX_KEY_LENGTH 0x3FFF
+
+//Keys are copied into blocks of at least this many bytes
+#ifndef AMAP_KEY_BLOCK_SIZE
+#define AMAP_KEY_BLOCK_SIZE 32
+#endif
+
 template <class T>
 class KeyValuePair {
 public:
-    bool valid = true;
-    char key[64];
+    KeyValuePair() : key(NULL), key_length(0), interned(0), valid(1) { }
+    //Either in the map's key pool or, for borrowed keys, in storage that
+    //outlives the map such as an in-situ parse buffer or a KeyTable
+    const char *key;
+    uint16_t key_length : 14;
+    //key belongs to a KeyTable and can be compared by address
+    uint16_t interned : 1;
+    uint16_t valid : 1;
     T value;
 };
 
 template <class T>
 class AMap : public AList<KeyValuePair<T>> {
 public:
-    AMap(AMap<T> &source) : AList<KeyValuePair<T>>(source) { };
-    AMap() { };
+    AMap(AMap<T> &source) : AList<KeyValuePair<T>>(source) {
+        keep_order = source.keep_order;
+        //The copy must not share keys with a map that may be freed first
+        for(auto &kvp : *this) {
+            //Interned keys already outlive both maps
+            if(kvp.interned || !kvp.valid)
+                continue;
+            char *key = alloc_key(kvp.key_length + 1);
+            if(key == NULL) {
+                //Fail the way a list that could not copy its elements does
+                Json::heapFree(this->elements, sizeof(KeyValuePair<T>) * this->_size);
+                this->elements = NULL;
+                this->_size = this->count = 0;
+                return;
+            }
+            memcpy(key, kvp.key, kvp.key_length + 1);
+            kvp.key = key;
+        }
+        //The copy starts without removed members
+        compact();
+    };
+    AMap(Json::Arena *arena = NULL) : AList<KeyValuePair<T>>(arena) { };
+    ~AMap() {
+        while(keys) {
+            KeyBlock *next = keys->next;
+            Json::heapFree(keys, sizeof(KeyBlock) + keys->size);
+            keys = next;
+        }
+        Json::release(this->arena, index, index_size());
+    }
+    //Space for a key of length - 1 characters that lives as long as the map,
+    //for callers that build the key in place and insert it with AMAP_KEY_ADOPT
+    char *alloc_key(size_t length) {
+        if(this->arena)
+            return (char*)Json::allocate(this->arena, length);
+        if(keys == NULL || keys->size - keys->used < length) {
+            size_t size = keys ? keys->size * 2 : AMAP_KEY_BLOCK_SIZE;
+            if(size < length)
+                size = length;
+            KeyBlock *block = (KeyBlock*)Json::heapAlloc(sizeof(KeyBlock) + size);
+            if(block == NULL)
+                return NULL;
+            block->next = keys;
+            block->size = size;
+            block->used = 0;
+            keys = block;
+        }
+        char *key = (char*)(keys + 1) + keys->used;
+        keys->used += length;
+        return key;
+    }
     using AList<KeyValuePair<T>>::get;
     void set(const char* key, T value) {
         T* current = get_create(key);
-        *current = value;
+        if(current)
+            *current = value;
     }
     T* get(const char* key) {
-        for(int i = 0; i < this->size(); i++) {
-            KeyValuePair<T> &kvp = this->get(i);
-            if(kvp.valid && strcmp(key, kvp.key) == 0)
-                return &kvp.value;
-        }
-        return NULL;
+        int slot = find(key, strlen(key));
+        return slot < 0 ? NULL : &this->get(slot).value;
     };
-    T *remove(const char* key) {
-        for(auto &kvp : *this) {
-            if(strcmp(key, kvp.key) == 0) {
-                kvp.valid = false;
-                return &kvp.value;
-            }
-        }
-        return NULL;
+    //Free the member's value and drop it. Returns false if there was none
+    bool remove(const char* key) {
+        return remove_slot(find(key, strlen(key)));
+    }
+    bool remove(const Json::Key &key) {
+        return remove_slot(find(key.str, key.length, key.str, key.hash));
+    }
+    //Removing a member normally moves the last member into its place. Set
+    //this to keep members in the order they were added instead: removed
+    //slots are then skipped over, with valid cleared, until they make up
+    //half the map and are squeezed out in one pass
+    bool keep_order = false;
+    //Lookup with the key's Json::hashKey() worked out ahead of time
+    T* get(const char *key, size_t length, uint32_t hash) {
+        int slot = find(key, length, NULL, hash);
+        return slot < 0 ? NULL : &this->get(slot).value;
+    }
+    //Lookups with a Key from a KeyTable compare interned members by address
+    T* get(const Json::Key &key) {
+        int slot = find(key.str, key.length, key.str, key.hash);
+        return slot < 0 ? NULL : &this->get(slot).value;
     }
     bool has(const char*key) {
         return bool(get(key));
     };
+    bool has(const Json::Key &key) {
+        return bool(get(key));
+    }
     bool has(int key) {
         char key_buf[64];
         itoa(key, key_buf, 10);
@@ -110,34 +224,268 @@ public:
     T &operator [](int key) {
         return *get_create(key);
     }
+    T &operator [](const Json::Key &key) {
+        return *get_create(key);
+    }
     T* get_create(int key) {
         char key_buf[64];
         itoa(key, key_buf, 10);
         return get_create(key_buf);
     }
     T* get_create(const char* key) {
-        T* current = get(key);
-        if(current == NULL) {
-            struct KeyValuePair<T> to_add;
-            to_add.value = default_init();
-            strncpy(to_add.key, key, 64);
-            //Try to find an empty item
-            for(auto &kvp : *this) {
-                if(!kvp.valid) {
-                    kvp = to_add;
-                    return &kvp.value;
-                }
-            }
-            //Otherwise add a new one
-            this->append(to_add);
-            current = &this->get(this->size() - 1).value;
-        }
-        return current;
+        return get_create(key, AMAP_KEY_COPY);
+    }
+    T* get_create(const char* key, int key_mode) {
+        size_t length = strlen(key);
+        int slot = find(key, length);
+        if(slot >= 0)
+            return &this->get(slot).value;
+        if(length > AMAP_MAX_KEY_LENGTH)
+            return NULL;
+        if(key_mode == AMAP_KEY_COPY && (key = copy_key(key, length)) == NULL)
+            return NULL;
+        return insert(key, length, false);
+    }
+    //The key is stored by address, so its table must outlive the map
+    T* get_create(const Json::Key &key) {
+        if(!key.valid())
+            return NULL;
+        int slot = find(key.str, key.length, key.str, key.hash);
+        if(slot >= 0)
+            return &this->get(slot).value;
+        return insert(key.str, key.length, true);
     }
 protected:
     virtual T default_init() {
         return T();
     }
+    //Release what a removed value owns
+    virtual void free_value(T &value) { }
 private:
+    //Open addressing table of key hashes and slot numbers, built once the
+    //map outgrows AMAP_INDEX_THRESHOLD. Slots are stored plus one so zero
+    //marks an empty bucket. Entries of removed members are marked deleted
+    //and count towards the load until the next rebuild.
+    static const int AMAP_INDEX_MAX = 0x7FFF;
+    static const uint16_t AMAP_INDEX_DELETED = 0xFFFF;
+    struct IndexEntry {
+        uint16_t hash;
+        uint16_t slot;
+    };
+    IndexEntry *index = NULL;
+    //Pool the map's own copies of keys are bump allocated from, newest
+    //block first; an arena map allocates keys from the arena instead
+    struct KeyBlock {
+        KeyBlock *next;
+        size_t size;
+        size_t used;
+    };
+    KeyBlock *keys = NULL;
+    uint16_t index_mask = 0;
+    uint16_t index_used = 0;
+    //Slots removed in keep_order mode, waiting to be squeezed out
+    int removed = 0;
+    //Bytes of the key pool held by removed members' keys
+    size_t garbage = 0;
+
+    //With interned set, key came from a KeyTable and a member holding the
+    //same pointer matches at once. Otherwise the text decides, since the
+    //member may have been interned in another table
+    static bool matches(KeyValuePair<T> &kvp, const char *key, size_t length, const char *interned) {
+        if(!kvp.valid)
+            return false;
+        if(interned && kvp.key == interned)
+            return true;
+        return kvp.key_length == length && memcmp(key, kvp.key, length) == 0;
+    }
+    int find(const char *key, size_t length, const char *interned = NULL, uint32_t hash = 0) {
+        if(index == NULL && this->size() > AMAP_INDEX_THRESHOLD && this->size() <= AMAP_INDEX_MAX)
+            index_build();
+        if(index == NULL) {
+            for(int i = 0; i < this->size(); i++) {
+                if(matches(this->get(i), key, length, interned))
+                    return i;
+            }
+            return -1;
+        }
+        //A hash that really is zero just comes out the same again
+        if(!interned && !hash)
+            hash = Json::hashKey(key, length);
+        for(uint16_t i = hash & index_mask; index[i].slot; i = (i + 1) & index_mask) {
+            if(index[i].slot != AMAP_INDEX_DELETED && index[i].hash == (uint16_t)(hash >> 16)
+               && matches(this->get(index[i].slot - 1), key, length, interned))
+                return index[i].slot - 1;
+        }
+        return -1;
+    }
+    T* insert(const char *key, size_t length, bool interned) {
+        struct KeyValuePair<T> to_add;
+        to_add.value = default_init();
+        to_add.key = key;
+        to_add.key_length = length;
+        to_add.interned = interned;
+        //A copied key stays in the pool
+        if(!this->append(to_add))
+            return NULL;
+        index_insert(this->size() - 1);
+        return &this->get(this->size() - 1).value;
+    }
+    //(Re)build the index sized for the current keys; the map falls back to
+    //linear search if it is too big to index or the allocation fails
+    void index_build() {
+        Json::release(this->arena, index, index_size());
+        index = NULL;
+        index_used = 0;
+        if(this->size() > AMAP_INDEX_MAX)
+            return;
+        size_t buckets = 32;
+        while(buckets < (size_t)this->size() * 2)
+            buckets *= 2;
+        index = (IndexEntry*)Json::allocate(this->arena, sizeof(IndexEntry) * buckets);
+        if(index == NULL)
+            return;
+        memset(index, 0, sizeof(IndexEntry) * buckets);
+        index_mask = buckets - 1;
+        for(int i = 0; i < this->size(); i++) {
+            if(this->get(i).valid)
+                index_add(i);
+        }
+    }
+    bool remove_slot(int slot) {
+        if(slot < 0)
+            return false;
+        KeyValuePair<T> &kvp = this->get(slot);
+        free_value(kvp.value);
+        if(in_pool(kvp.key))
+            garbage += kvp.key_length + 1;
+        index_remove(slot);
+        if(keep_order) {
+            kvp.valid = false;
+            kvp.key = "";
+            kvp.key_length = 0;
+            kvp.value = T();
+            if(++removed * 2 >= this->size())
+                compact();
+        }
+        else {
+            int last = this->size() - 1;
+            if(slot != last) {
+                index_move(last, slot);
+                memcpy(&kvp, &this->get(last), sizeof(kvp));
+            }
+            this->count--;
+        }
+        //Rewrite the pool once removed keys take up most of it
+        if(garbage >= AMAP_KEY_BLOCK_SIZE && garbage * 2 > pool_used())
+            compact_keys();
+        return true;
+    }
+    //Close up removed slots, keeping the order of the rest
+    void compact() {
+        int used = 0;
+        for(int i = 0; i < this->size(); i++) {
+            if(!this->get(i).valid)
+                continue;
+            if(i != used)
+                memcpy(&this->get(used), &this->get(i), sizeof(KeyValuePair<T>));
+            used++;
+        }
+        if(used == this->size())
+            return;
+        this->count = used;
+        removed = 0;
+        if(index)
+            index_build();
+    }
+    bool in_pool(const char *key) {
+        for(KeyBlock *block = keys; block; block = block->next) {
+            const char *start = (const char*)(block + 1);
+            if(key >= start && key < start + block->used)
+                return true;
+        }
+        return false;
+    }
+    size_t pool_used() {
+        size_t used = 0;
+        for(KeyBlock *block = keys; block; block = block->next)
+            used += block->used;
+        return used;
+    }
+    //Copy the keys still in use into one new block and free the old ones;
+    //if that cannot be allocated the pool stays as it is
+    void compact_keys() {
+        size_t size = pool_used() - garbage;
+        if(size < AMAP_KEY_BLOCK_SIZE)
+            size = AMAP_KEY_BLOCK_SIZE;
+        KeyBlock *block = (KeyBlock*)Json::heapAlloc(sizeof(KeyBlock) + size);
+        if(block == NULL)
+            return;
+        block->next = NULL;
+        block->size = size;
+        block->used = 0;
+        for(auto &kvp : *this) {
+            if(!kvp.valid || kvp.interned || !in_pool(kvp.key))
+                continue;
+            char *key = (char*)(block + 1) + block->used;
+            memcpy(key, kvp.key, kvp.key_length + 1);
+            block->used += kvp.key_length + 1;
+            kvp.key = key;
+        }
+        while(keys) {
+            KeyBlock *next = keys->next;
+            Json::heapFree(keys, sizeof(KeyBlock) + keys->size);
+            keys = next;
+        }
+        keys = block;
+        garbage = 0;
+    }
+    //The index bucket that refers to slot
+    IndexEntry *index_entry(int slot) {
+        KeyValuePair<T> &kvp = this->get(slot);
+        uint32_t hash = Json::hashKey(kvp.key, kvp.key_length);
+        for(uint16_t i = hash & index_mask; index[i].slot; i = (i + 1) & index_mask) {
+            if(index[i].slot == slot + 1)
+                return &index[i];
+        }
+        return NULL;
+    }
+    void index_remove(int slot) {
+        IndexEntry *entry = index ? index_entry(slot) : NULL;
+        if(entry)
+            entry->slot = AMAP_INDEX_DELETED;
+    }
+    void index_move(int from, int to) {
+        IndexEntry *entry = index ? index_entry(from) : NULL;
+        if(entry)
+            entry->slot = to + 1;
+    }
+    size_t index_size() {
+        return index ? sizeof(IndexEntry) * (index_mask + 1) : 0;
+    }
+    void index_add(int slot) {
+        KeyValuePair<T> &kvp = this->get(slot);
+        uint32_t hash = Json::hashKey(kvp.key, kvp.key_length);
+        uint16_t i = hash & index_mask;
+        while(index[i].slot)
+            i = (i + 1) & index_mask;
+        index[i].hash = hash >> 16;
+        index[i].slot = slot + 1;
+        index_used++;
+    }
+    void index_insert(int slot) {
+        if(index == NULL)
+            return;
+        //Keep the table at most three quarters full
+        if((index_used + 1) * 4 > (index_mask + 1) * 3)
+            index_build();
+        else
+            index_add(slot);
+    }
+    char *copy_key(const char *key, size_t length) {
+        char *copy = alloc_key(length + 1);
+        if(copy)
+            memcpy(copy, key, length + 1);
+        return copy;
+    }
     AMap(const AMap&);
 };
\ No newline at end of file
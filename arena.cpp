@@ -0,0 +1,91 @@
+#include "arena.h"
+
+using namespace Json;
+
+static size_t align(size_t size) {
+    return (size + JSON_ARENA_ALIGN - 1) & ~(size_t)(JSON_ARENA_ALIGN - 1);
+}
+
+static char *align(char *ptr) {
+    return (char *)align((size_t)ptr);
+}
+
+Arena::Arena(void *buffer, size_t size)
+    : chunks(NULL), buffer((char *)buffer), chunk_size(0), _used(0) {
+    pos = align(this->buffer);
+    end = this->buffer + size;
+    if(pos > end) pos = end;
+    last = NULL;
+}
+
+Arena::Arena(size_t chunk_size)
+    : chunks(NULL), buffer(NULL), pos(NULL), end(NULL), last(NULL),
+      chunk_size(chunk_size), _used(0) { }
+
+Arena::~Arena() {
+    while(chunks) {
+        Chunk *next = chunks->next;
+        heapFree(chunks, chunks->size);
+        chunks = next;
+    }
+}
+
+bool Arena::grow(size_t size) {
+    //Fixed buffers cannot grow
+    if(!chunk_size)
+        return false;
+    size_t header = align(sizeof(Chunk));
+    size_t length = header + size > chunk_size ? header + size : chunk_size;
+    Chunk *chunk = (Chunk *)heapAlloc(length);
+    if(!chunk)
+        return false;
+    chunk->next = chunks;
+    chunk->size = length;
+    chunks = chunk;
+    pos = (char *)chunk + header;
+    end = (char *)chunk + length;
+    return true;
+}
+
+void *Arena::alloc(size_t size) {
+    size = align(size ? size : 1);
+    if(size > (size_t)(end - pos) && !grow(size))
+        return NULL;
+    last = pos;
+    pos += size;
+    _used += size;
+    return last;
+}
+
+void *Arena::realloc(void *ptr, size_t old_size, size_t size) {
+    if(!ptr)
+        return alloc(size);
+    //The most recent block can simply be extended
+    if(ptr == last && align(size) <= (size_t)(end - last)) {
+        _used += align(size) - align(old_size);
+        pos = last + align(size);
+        return ptr;
+    }
+    void *output = alloc(size);
+    if(output)
+        memcpy(output, ptr, old_size < size ? old_size : size);
+    return output;
+}
+
+void Arena::reset() {
+    _used = 0;
+    last = NULL;
+    if(!chunk_size) {
+        pos = align(buffer);
+        return;
+    }
+    if(!chunks)
+        return;
+    while(chunks->next) {
+        Chunk *next = chunks->next->next;
+        heapFree(chunks->next, chunks->next->size);
+        chunks->next = next;
+    }
+    pos = (char *)chunks + align(sizeof(Chunk));
+    end = (char *)chunks + chunks->size;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef __AVR__
+#include <new.h>
+#else
+#include <new>
+#endif
+#include "stats.h"
+
+//Size of the heap chunks a growable arena requests at a time
+#ifndef JSON_ARENA_CHUNK_SIZE
+#define JSON_ARENA_CHUNK_SIZE 512
+#endif
+
+//Alignment of every arena allocation
+#ifndef JSON_ARENA_ALIGN
+#ifdef __AVR__
+#define JSON_ARENA_ALIGN 1
+#else
+#define JSON_ARENA_ALIGN 8
+#endif
+#endif
+
+namespace Json {
+
+    /* Bump-pointer allocator for parsed documents. Containers, their element
+     * blocks and strings created through an arena are never freed one by one;
+     * the whole document goes away with reset() or the arena's destructor.
+     * Values that live in an arena are flagged so free_parsed() ignores them. */
+    class Arena {
+    public:
+        /* Allocate out of a caller-supplied buffer. alloc() returns NULL
+         * once the buffer is exhausted. */
+        Arena(void *buffer, size_t size);
+        /* Allocate out of heap chunks of at least chunk_size bytes. */
+        Arena(size_t chunk_size = JSON_ARENA_CHUNK_SIZE);
+        ~Arena();
+
+        void *alloc(size_t size);
+        /* Grows in place when ptr is the most recent allocation, otherwise
+         * copies; the old block is only reclaimed by reset(). */
+        void *realloc(void *ptr, size_t old_size, size_t size);
+        /* Release everything allocated so far. A growable arena keeps its
+         * newest chunk so a parse/reset loop does not touch the heap. */
+        void reset();
+        size_t used() { return _used; }
+
+    private:
+        struct Chunk {
+            Chunk *next;
+            size_t size;
+        };
+        bool grow(size_t size);
+
+        Chunk *chunks;
+        char *buffer;
+        char *pos;
+        char *end;
+        char *last;
+        size_t chunk_size;
+        size_t _used;
+
+        Arena(const Arena&);
+    };
+
+    inline void *allocate(Arena *arena, size_t size) {
+        return arena ? arena->alloc(size) : heapAlloc(size);
+    }
+    inline void *reallocate(Arena *arena, void *ptr, size_t old_size, size_t size) {
+        return arena ? arena->realloc(ptr, old_size, size) : heapRealloc(ptr, old_size, size);
+    }
+    //size is what was allocated, for the statistics
+    inline void release(Arena *arena, void *ptr, size_t size) {
+        if(!arena) heapFree(ptr, size);
+    }
+    //Construct a T(arena) in the arena, or a plain heap T if there is none
+    template <class T>
+    T *create(Arena *arena) {
+        if(!arena)
+            return new T();
+        void *mem = arena->alloc(sizeof(T));
+        return mem ? new (mem) T(arena) : NULL;
+    }
+}
@@ -0,0 +1,249 @@
+// Parse and serialize benchmarks for the host build.
+//
+//   json_bench [--quick] [--min-time SECONDS] [document...]
+//
+// Every operation runs over each document of a fixed corpus, generated
+// from a fixed seed so runs are comparable, and reports throughput over
+// the document's JSON text, time per operation and heap allocations per
+// operation. --quick runs each once, as a check that everything works.
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include "json.h"
+
+// Allocations are counted by standing in for the C allocator, which the
+// library and operator new both go through.
+static unsigned long allocations = 0;
+
+#ifdef __GLIBC__
+#define COUNTS_ALLOCATIONS 1
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+void *calloc(size_t count, size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+void *realloc(void *ptr, size_t size) {
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+}
+#else
+#define COUNTS_ALLOCATIONS 0
+#endif
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Deterministic pseudo random numbers, the same on every platform.
+static uint32_t seed;
+static uint32_t next(uint32_t limit) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % limit;
+}
+
+static void append(std::string &out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void append(std::string &out, const char *format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    out += buf;
+}
+
+// A single sensor reading, the typical message on the wire.
+static std::string telemetry() {
+    return "{\"device\":\"sensor-0042\",\"seq\":183211,\"ts\":1700000123456,"
+           "\"temp\":21.5,\"humidity\":40.25,\"battery\":3.71,\"ok\":true,"
+           "\"fault\":null,\"tags\":[\"roof\",\"north\"]}";
+}
+
+// A large nested configuration of mostly short keys and small values.
+static std::string config() {
+    std::string out = "{\"version\":3,\"services\":[";
+    for (int i = 0; i < 300; i++) {
+        if (i)
+            out += ',';
+        append(out, "{\"name\":\"service-%d\",\"enabled\":%s,\"port\":%u,\"hosts\":[", i,
+               next(4) ? "true" : "false", 1024 + next(60000));
+        for (int h = 0; h < 3; h++)
+            append(out, "%s\"10.%u.%u.%u\"", h ? "," : "", next(256), next(256), next(256));
+        append(out, "],\"limits\":{\"cpu\":%u.%u,\"memory\":%u,\"retries\":%u},", next(8), next(10),
+               64 << next(6), next(5));
+        append(out, "\"labels\":{\"team\":\"team-%u\",\"tier\":\"%s\"}}", next(20),
+               next(2) ? "frontend" : "backend");
+    }
+    out += "]}";
+    return out;
+}
+
+// Samples with up to 17 significant digits, where number conversion
+// dominates.
+static std::string floats() {
+    std::string out = "{\"rate\":1000,\"samples\":[";
+    for (int i = 0; i < 5000; i++) {
+        double sample = ((double)next(2000000) - 1000000) / (1 + next(100000));
+        append(out, "%s%.*g", i ? "," : "", 3 + (int)next(15), sample);
+    }
+    out += "]}";
+    return out;
+}
+
+// Strings of every length with some escapes and UTF-8 in them.
+static std::string strings() {
+    static const char *const pieces[] = {
+        "alpha", "beta ", "\\\"quoted\\\"", "line\\nbreak", "tab\\t", "caf\\u00e9",
+        "\xc3\xbc" "ber", "path\\/to", "\xe2\x82\xac" "10", "x",
+    };
+    std::string out = "[";
+    for (int i = 0; i < 2000; i++) {
+        out += i ? ",\"" : "\"";
+        for (uint32_t n = next(8); n > 0; n--)
+            out += pieces[next(sizeof(pieces) / sizeof(pieces[0]))];
+        out += '\"';
+    }
+    out += ']';
+    return out;
+}
+
+struct Document {
+    const char *name;
+    std::string text;
+    Json::Value value;
+};
+
+// Discards output, so print measures the encoder and not a destination.
+class NullPrint : public Print {
+public:
+    size_t write(uint8_t) { return 1; }
+    size_t write(const uint8_t *, size_t size) { return size; }
+    using Print::write;
+};
+
+static volatile size_t result;
+
+static void runOp(Document &doc, const char *op, int iterations) {
+    if (strcmp(op, "parse") == 0) {
+        for (int i = 0; i < iterations; i++) {
+            Json::Value value = Json::parse(doc.text.data(), doc.text.size());
+            result += value.type;
+            value.free_parsed();
+        }
+    }
+    else if (strcmp(op, "print") == 0) {
+        NullPrint sink;
+        for (int i = 0; i < iterations; i++)
+            result += Json::print(doc.value, sink);
+    }
+    else if (strcmp(op, "dump") == 0) {
+        static char buffer[1 << 20];
+        for (int i = 0; i < iterations; i++)
+            result += Json::dump(doc.value, buffer, sizeof(buffer));
+    }
+    else if (strcmp(op, "measure") == 0) {
+        for (int i = 0; i < iterations; i++)
+            result += Json::measure(doc.value);
+    }
+    else if (strcmp(op, "clone") == 0) {
+        for (int i = 0; i < iterations; i++) {
+            Json::Value copy = doc.value.isObject() ? Json::Value(doc.value.asObject().clone())
+                                                    : Json::Value(doc.value.asArray().clone());
+            result += copy.type;
+            copy.free_parsed();
+        }
+    }
+    else if (strcmp(op, "share") == 0) {
+        for (int i = 0; i < iterations; i++) {
+            Json::Value copy = doc.value.isObject() ? Json::Value(doc.value.asObject().share())
+                                                    : Json::Value(doc.value.asArray().share());
+            result += copy.type;
+            copy.free_parsed();
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    bool quick = false;
+    double min_time = 0.25;
+    int selected = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0)
+            quick = true;
+        else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+            min_time = atof(argv[++i]);
+        else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: %s [--quick] [--min-time SECONDS] [document...]\n", argv[0]);
+            return 2;
+        }
+        else
+            selected++;
+    }
+
+    seed = 1;
+    Document docs[] = {
+        { "telemetry", telemetry(), Json::Value() },
+        { "config", config(), Json::Value() },
+        { "floats", floats(), Json::Value() },
+        { "strings", strings(), Json::Value() },
+    };
+    static const char *const ops[] = { "parse", "print", "dump", "measure", "clone", "share" };
+
+    printf("%-10s %-8s %8s %10s %9s %12s %10s\n", "document", "op", "bytes", "iters", "MB/s", "ns/op",
+           COUNTS_ALLOCATIONS ? "allocs/op" : "");
+    int failures = 0;
+    for (Document &doc : docs) {
+        bool wanted = selected == 0;
+        for (int i = 1; i < argc; i++)
+            wanted |= strcmp(argv[i], doc.name) == 0;
+        if (!wanted)
+            continue;
+        doc.value = Json::parse(doc.text.data(), doc.text.size());
+        if (doc.value.isInvalid() || Json::measure(doc.value) <= 0) {
+            printf("%-10s failed to parse\n", doc.name);
+            failures++;
+            continue;
+        }
+        for (const char *op : ops) {
+            // Double the count until a run takes long enough to time
+            int iterations = 1;
+            double elapsed;
+            unsigned long allocated;
+            for (;;) {
+                allocations = 0;
+                double start = now();
+                runOp(doc, op, iterations);
+                elapsed = now() - start;
+                allocated = allocations;
+                if (quick || elapsed >= min_time || iterations >= (1 << 30))
+                    break;
+                iterations *= 2;
+            }
+            double per_op = elapsed / iterations;
+            printf("%-10s %-8s %8zu %10d %9.1f %12.0f", doc.name, op, doc.text.size(), iterations,
+                   doc.text.size() / per_op / 1e6, per_op * 1e9);
+            if (COUNTS_ALLOCATIONS)
+                printf(" %10.1f", (double)allocated / iterations);
+            printf("\n");
+        }
+        doc.value.free_parsed();
+    }
+    return failures ? 1 : 0;
+}
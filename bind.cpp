@@ -0,0 +1,53 @@
+#include "bind.h"
+
+using namespace Json;
+
+uint32_t Json::bindKeyNarrow(const char *const *names, uint32_t candidates, size_t offset,
+                             const char *chunk, size_t length)
+{
+    for (int i = 0; candidates >> i; i++)
+    {
+        if (!(candidates >> i & 1))
+            continue;
+        if (strlen(names[i]) < offset + length || memcmp(names[i] + offset, chunk, length))
+            candidates &= ~((uint32_t) 1 << i);
+    }
+    return candidates;
+}
+
+int Json::bindKeyFind(const char *const *names, uint32_t candidates, size_t length)
+{
+    for (int i = 0; candidates >> i; i++)
+        if ((candidates >> i & 1) && strlen(names[i]) == length)
+            return i;
+    return -1;
+}
+
+int Json::skipBound(aJsonStream &in, Token &token)
+{
+    int depth = 0;
+    for (;;)
+    {
+        switch (token.type)
+        {
+        case JSON_TOKEN_START_OBJECT:
+        case JSON_TOKEN_START_ARRAY:
+            depth++;
+            break;
+        case JSON_TOKEN_END_OBJECT:
+        case JSON_TOKEN_END_ARRAY:
+            depth--;
+            break;
+        case JSON_TOKEN_ERROR:
+        case JSON_TOKEN_END:
+            return EOF;
+        default:
+            break;
+        }
+        // The rest of a long string comes as more tokens
+        if (depth <= 0 && !token.more)
+            return depth < 0 ? EOF : 0;
+        if (in.nextToken(&token) == JSON_TOKEN_ERROR)
+            return EOF;
+    }
+}
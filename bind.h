@@ -0,0 +1,221 @@
+#pragma once
+
+#include "json.h"
+#include "writer.h"
+
+/* Read and write plain structs as JSON objects without building a Value
+ * tree. Declare which members map to keys once, at namespace scope:
+ *
+ *   struct Reading { long id; double temp; char unit[8]; Position at; };
+ *   JSON_BIND(Reading, id, temp, unit, at)
+ *
+ *   Reading reading;
+ *   if (Json::parseBound(stream, reading) == 0) ...
+ *   Json::printBound(reading, Serial);
+ *
+ * Members may be bool, integers, float, double, char arrays and other
+ * bound structs. Keys are checked against the member names chunk by
+ * chunk as they stream in, then dispatched by a switch on a hash computed
+ * at compile time, so two names that collide fail to compile. Unknown keys,
+ * nulls and values of the wrong type leave the member unchanged; strings
+ * longer than their array are cut short. Up to JSON_BIND_MAX_FIELDS
+ * members per struct. */
+
+#define JSON_BIND_MAX_FIELDS 16
+
+//FNV-1a, the same at compile time and run time
+#define JSON_BIND_HASH_SEED 2166136261u
+#define JSON_BIND_HASH_PRIME 16777619u
+
+namespace Json {
+
+    constexpr uint32_t bindHash(const char *name, uint32_t hash = JSON_BIND_HASH_SEED) {
+        return *name ? bindHash(name + 1, (hash ^ (uint8_t)*name) * JSON_BIND_HASH_PRIME) : hash;
+    }
+
+    /* Clear the bits of candidates, one per entry of names, whose name
+     * does not go on with the length bytes of chunk at offset. */
+    uint32_t bindKeyNarrow(const char *const *names, uint32_t candidates, size_t offset,
+                           const char *chunk, size_t length);
+    /* The entry of names a key of length bytes that narrowed candidates
+     * down is equal to, or -1. */
+    int bindKeyFind(const char *const *names, uint32_t candidates, size_t length);
+
+    /* Consume the value token starts, for keys no member is bound to.
+     * Returns 0, or EOF if the input is malformed. */
+    int skipBound(aJsonStream &in, Token &token);
+
+    /* Read the value token starts into out. */
+    template <class T>
+    int readBoundNumber(aJsonStream &in, Token &token, T &out) {
+        if (token.type != JSON_TOKEN_NUMBER)
+            return skipBound(in, token);
+        out = token.value.isInt() ? (T)token.value.asInt64() : (T)token.value.asDouble();
+        return 0;
+    }
+
+    inline int readBound(aJsonStream &in, Token &token, bool &out) {
+        if (token.type != JSON_TOKEN_BOOLEAN)
+            return skipBound(in, token);
+        out = token.value.asBool();
+        return 0;
+    }
+
+    template <size_t N>
+    int readBound(aJsonStream &in, Token &token, char (&out)[N]) {
+        if (token.type != JSON_TOKEN_STRING)
+            return skipBound(in, token);
+        size_t used = 0;
+        for (;;) {
+            size_t take = token.length < N - 1 - used ? token.length : N - 1 - used;
+            memcpy(out + used, token.chunk, take);
+            used += take;
+            if (!token.more)
+                break;
+            if (in.nextToken(&token) != JSON_TOKEN_STRING)
+                return EOF;
+        }
+        out[used] = 0;
+        return 0;
+    }
+
+    // A bound struct, through the jsonMemberNames() and jsonReadMember()
+    // JSON_BIND defines
+    template <class T>
+    int readBound(aJsonStream &in, Token &token, T &out) {
+        if (token.type != JSON_TOKEN_START_OBJECT)
+            return skipBound(in, token);
+        for (;;) {
+            if (in.nextToken(&token) == JSON_TOKEN_END_OBJECT)
+                return 0;
+            if (token.type != JSON_TOKEN_KEY)
+                return EOF;
+            int count;
+            const char *const *names = jsonMemberNames(out, count);
+            uint32_t candidates = ((uint32_t) 1 << count) - 1;
+            size_t length = 0;
+            for (;;) {
+                candidates = bindKeyNarrow(names, candidates, length, token.chunk, token.length);
+                length += token.length;
+                if (!token.more)
+                    break;
+                if (in.nextToken(&token) != JSON_TOKEN_KEY)
+                    return EOF;
+            }
+            int field = bindKeyFind(names, candidates, length);
+            if (in.nextToken(&token) == JSON_TOKEN_ERROR)
+                return EOF;
+            if (field < 0 ? skipBound(in, token) : jsonReadMember(in, token, out, bindHash(names[field])))
+                return EOF;
+        }
+    }
+
+    inline void writeBound(Writer &out, bool value) {
+        if (value)
+            out.put("true", 4);
+        else
+            out.put("false", 5);
+    }
+
+    template <size_t N>
+    void writeBound(Writer &out, const char (&value)[N]) {
+        printStringPtr(value, out);
+    }
+
+    template <class T>
+    void writeBound(Writer &out, const T &value) {
+        jsonWriteObject(out, value);
+    }
+
+#define JSON_BIND_NUMBER(T, print) \
+    inline int readBound(aJsonStream &in, Token &token, T &out) { return readBoundNumber(in, token, out); } \
+    inline void writeBound(Writer &out, const T &value) { print(value, out); }
+
+    JSON_BIND_NUMBER(signed char, printInt)
+    JSON_BIND_NUMBER(unsigned char, printInt)
+    JSON_BIND_NUMBER(short, printInt)
+    JSON_BIND_NUMBER(unsigned short, printInt)
+    JSON_BIND_NUMBER(int, printInt)
+    JSON_BIND_NUMBER(unsigned int, printInt)
+    JSON_BIND_NUMBER(long, printInt)
+    JSON_BIND_NUMBER(unsigned long, printInt)
+    JSON_BIND_NUMBER(long long, printInt)
+    JSON_BIND_NUMBER(unsigned long long, printInt)
+    JSON_BIND_NUMBER(float, printFloat)
+    JSON_BIND_NUMBER(double, printFloat)
+
+#undef JSON_BIND_NUMBER
+
+    /* Read one JSON document from in into out, leaving the stream ready
+     * for the next. Returns 0, or EOF if the input is malformed. */
+    template <class T>
+    int parseBound(aJsonStream &in, T &out) {
+        Token token;
+        if (in.nextToken(&token) == JSON_TOKEN_ERROR || readBound(in, token, out))
+            return EOF;
+        return in.nextToken(&token) == JSON_TOKEN_END ? 0 : EOF;
+    }
+
+    /* Write value as a JSON object. Returns the number of bytes written. */
+    template <class T>
+    int printBound(const T &value, Print &print) {
+        Writer out(print);
+        writeBound(out, value);
+        out.flush();
+        return out.written;
+    }
+}
+
+//Apply m to each argument, for up to JSON_BIND_MAX_FIELDS of them
+#define JSON_BIND_EACH_1(m, a) m(a)
+#define JSON_BIND_EACH_2(m, a, ...) m(a) JSON_BIND_EACH_1(m, __VA_ARGS__)
+#define JSON_BIND_EACH_3(m, a, ...) m(a) JSON_BIND_EACH_2(m, __VA_ARGS__)
+#define JSON_BIND_EACH_4(m, a, ...) m(a) JSON_BIND_EACH_3(m, __VA_ARGS__)
+#define JSON_BIND_EACH_5(m, a, ...) m(a) JSON_BIND_EACH_4(m, __VA_ARGS__)
+#define JSON_BIND_EACH_6(m, a, ...) m(a) JSON_BIND_EACH_5(m, __VA_ARGS__)
+#define JSON_BIND_EACH_7(m, a, ...) m(a) JSON_BIND_EACH_6(m, __VA_ARGS__)
+#define JSON_BIND_EACH_8(m, a, ...) m(a) JSON_BIND_EACH_7(m, __VA_ARGS__)
+#define JSON_BIND_EACH_9(m, a, ...) m(a) JSON_BIND_EACH_8(m, __VA_ARGS__)
+#define JSON_BIND_EACH_10(m, a, ...) m(a) JSON_BIND_EACH_9(m, __VA_ARGS__)
+#define JSON_BIND_EACH_11(m, a, ...) m(a) JSON_BIND_EACH_10(m, __VA_ARGS__)
+#define JSON_BIND_EACH_12(m, a, ...) m(a) JSON_BIND_EACH_11(m, __VA_ARGS__)
+#define JSON_BIND_EACH_13(m, a, ...) m(a) JSON_BIND_EACH_12(m, __VA_ARGS__)
+#define JSON_BIND_EACH_14(m, a, ...) m(a) JSON_BIND_EACH_13(m, __VA_ARGS__)
+#define JSON_BIND_EACH_15(m, a, ...) m(a) JSON_BIND_EACH_14(m, __VA_ARGS__)
+#define JSON_BIND_EACH_16(m, a, ...) m(a) JSON_BIND_EACH_15(m, __VA_ARGS__)
+#define JSON_BIND_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, name, ...) name
+#define JSON_BIND_EACH(m, ...) \
+    JSON_BIND_PICK(__VA_ARGS__, JSON_BIND_EACH_16, JSON_BIND_EACH_15, JSON_BIND_EACH_14, JSON_BIND_EACH_13, \
+                   JSON_BIND_EACH_12, JSON_BIND_EACH_11, JSON_BIND_EACH_10, JSON_BIND_EACH_9, JSON_BIND_EACH_8, \
+                   JSON_BIND_EACH_7, JSON_BIND_EACH_6, JSON_BIND_EACH_5, JSON_BIND_EACH_4, JSON_BIND_EACH_3, \
+                   JSON_BIND_EACH_2, JSON_BIND_EACH_1)(m, __VA_ARGS__)
+
+#define JSON_BIND_NAME(field) #field,
+
+#define JSON_BIND_READ(field) \
+    case Json::bindHash(#field): \
+        return Json::readBound(in, token, object.field);
+
+#define JSON_BIND_WRITE(field) \
+    out.put(separator); \
+    separator = ','; \
+    out.put("\"" #field "\":", sizeof("\"" #field "\":") - 1); \
+    Json::writeBound(out, object.field);
+
+#define JSON_BIND(Type, ...) \
+    inline const char *const *jsonMemberNames(const Type &, int &count) { \
+        static const char *const names[] = { JSON_BIND_EACH(JSON_BIND_NAME, __VA_ARGS__) }; \
+        count = sizeof(names) / sizeof(names[0]); \
+        return names; \
+    } \
+    inline int jsonReadMember(Json::aJsonStream &in, Json::Token &token, Type &object, uint32_t hash) { \
+        switch (hash) { \
+        JSON_BIND_EACH(JSON_BIND_READ, __VA_ARGS__) \
+        } \
+        return Json::skipBound(in, token); \
+    } \
+    inline void jsonWriteObject(Json::Writer &out, const Type &object) { \
+        char separator = '{'; \
+        JSON_BIND_EACH(JSON_BIND_WRITE, __VA_ARGS__) \
+        out.put('}'); \
+    }
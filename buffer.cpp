@@ -0,0 +1,558 @@
+#include "json.h"
+#include "scan.h"
+#include "number.h"
+
+using namespace Json;
+
+/* Parser over a document that is already fully in memory. It walks a
+ * pointer instead of going through aJsonStream::getch(), so there is no
+ * per-byte virtual call and no ungetch() round trip. In in-situ mode the
+ * buffer is writable and strings are unescaped in place, so every string
+ * value and key ends up pointing into it; otherwise strings are copied. */
+class BufferParser
+{
+public:
+    BufferParser(const char *buf, size_t len, bool insitu, const ParseOptions &options)
+        : p(buf), end(buf + len), insitu(insitu), options(options), lazy(NULL), lazy_end(NULL), depth(0)
+        {}
+
+    int parseValue(Value *item, const char *const *filter);
+    int parseLazy(LazyNode *node, Value *item);
+    bool atEnd() { return this->skip() == EOF; }
+
+private:
+    int skip();
+    char *parseString(Object *owner = NULL, char *local = NULL);
+    Key internKey();
+    int parseNumber(Value *item);
+    int parseArray(Value *item, const char *const *filter);
+    int parseObject(Value *item, const char *const *filter);
+    int skipValue();
+    int parseKeyword(const char *keyword, size_t len);
+
+    const char *p;
+    const char *end;
+    bool insitu;
+    const ParseOptions &options;
+    // Next node of a LazyDocument, whose value is left unparsed when
+    // reached, and the end of the nodes below the one being parsed
+    LazyNode *lazy;
+    LazyNode *lazy_end;
+    // Containers open around the value being parsed
+    uint8_t depth;
+};
+
+// Read the four hex digits of a \u escape, returns -1 if malformed.
+static long readHex4(const char *p, const char *end)
+{
+    if (end - p < 4)
+        return -1;
+    long code = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        int digit = hexValue(p[i]);
+        if (digit < 0)
+            return -1;
+        code = (code << 4) | digit;
+    }
+    return code;
+}
+
+char *Json::writeUtf8(char *out, long code)
+{
+    if (code < 0x80)
+    {
+        *out++ = code;
+    }
+    else if (code < 0x800)
+    {
+        *out++ = 0xC0 | (code >> 6);
+        *out++ = 0x80 | (code & 0x3F);
+    }
+    else if (code < 0x10000)
+    {
+        *out++ = 0xE0 | (code >> 12);
+        *out++ = 0x80 | ((code >> 6) & 0x3F);
+        *out++ = 0x80 | (code & 0x3F);
+    }
+    else
+    {
+        *out++ = 0xF0 | (code >> 18);
+        *out++ = 0x80 | ((code >> 12) & 0x3F);
+        *out++ = 0x80 | ((code >> 6) & 0x3F);
+        *out++ = 0x80 | (code & 0x3F);
+    }
+    return out;
+}
+
+char *Json::unescape(const char *in, const char *end, char *out)
+{
+    while (in < end)
+    {
+        if (*in != '\\')
+        {
+            *out++ = *in++;
+            continue;
+        }
+        in++;
+        switch (*in++)
+        {
+        case '\\':
+            *out++ = '\\';
+            break;
+        case '\"':
+            *out++ = '\"';
+            break;
+        case '/':
+            *out++ = '/';
+            break;
+        case 'b':
+            *out++ = '\b';
+            break;
+        case 'f':
+            *out++ = '\f';
+            break;
+        case 'n':
+            *out++ = '\n';
+            break;
+        case 'r':
+            *out++ = '\r';
+            break;
+        case 't':
+            *out++ = '\t';
+            break;
+        case 'u':
+        {
+            long code = readHex4(in, end);
+            if (code < 0)
+                return NULL;
+            in += 4;
+            // A high surrogate needs its low half to form the code point
+            if (code >= 0xD800 && code <= 0xDBFF && end - in >= 6 && in[0] == '\\' && in[1] == 'u')
+            {
+                long low = readHex4(in + 2, end);
+                if (low >= 0xDC00 && low <= 0xDFFF)
+                {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    in += 6;
+                }
+            }
+            // The encoding is never longer than the escape it replaces
+            out = writeUtf8(out, code);
+            break;
+        }
+        default:
+            return NULL;
+        }
+    }
+    return out;
+}
+
+Value Json::parse(const char *value, const ParseOptions &options)
+{
+    return parse(value, strlen(value), options);
+}
+
+Value Json::parse(const char *value, size_t len, const ParseOptions &options)
+{
+#ifdef JSON_STATS
+    StatsTimer timer(stats.parse_micros);
+    stats.bytes_parsed += len;
+#endif
+    Value output;
+    BufferParser parser(value, len, false, options);
+    parser.parseValue(&output, options.filter);
+    return output;
+}
+
+Value Json::parseInSitu(char *buf, size_t len, const ParseOptions &options)
+{
+#ifdef JSON_STATS
+    StatsTimer timer(stats.parse_micros);
+    stats.bytes_parsed += len;
+#endif
+    Value output;
+    BufferParser parser(buf, len, true, options);
+    parser.parseValue(&output, options.filter);
+    return output;
+}
+
+int Json::parseToken(Value *item, char *buf, size_t len, bool insitu, const ParseOptions &options)
+{
+    BufferParser parser(buf, len, insitu, options);
+    if (parser.parseValue(item, NULL) || !parser.atEnd())
+    {
+        item->free_parsed();
+        *item = Value::invalid();
+        return EOF;
+    }
+    return 0;
+}
+
+int Json::parseLazy(LazyNode *node, Value *item)
+{
+    BufferParser parser(node->start, node->end - node->start, false, node->doc->options);
+    return parser.parseLazy(node, item);
+}
+
+// Parse the value of node, with each container nested in it and each
+// member value standing in as a lazy value for the node that indexed it.
+int BufferParser::parseLazy(LazyNode *node, Value *item)
+{
+    lazy = node + 1;
+    lazy_end = node + node->subtree;
+    if (*p == '[')
+        return this->parseArray(item, NULL);
+    if (*p == '{')
+        return this->parseObject(item, NULL);
+    return this->parseValue(item, NULL);
+}
+
+// Jump whitespace, returns the next character without consuming it.
+int BufferParser::skip()
+{
+    p = skipWhitespace(p, end);
+    return p < end ? (unsigned char) *p : EOF;
+}
+
+int BufferParser::parseKeyword(const char *keyword, size_t len)
+{
+    if ((size_t) (end - p) < len || memcmp(p, keyword, len))
+        return EOF;
+    p += len;
+    return 0;
+}
+
+int BufferParser::parseValue(Value *item, const char *const *filter)
+{
+#ifdef JSON_STATS
+    stats.nodes++;
+#endif
+    int in = this->skip();
+    // A filter path going into a plain value cannot match
+    if (filter && in != '[' && in != '{')
+    {
+        *item = Value::invalid();
+        return this->skipValue();
+    }
+    // Nodes are in document order, so this is the value at p
+    if (lazy < lazy_end && lazy->start == p)
+    {
+        *item = Value(lazy);
+        p = lazy->end;
+        lazy += lazy->subtree;
+        return 0;
+    }
+    else if (in == '\"')
+    {
+        char local[JSON_INLINE_SIZE];
+        char *str = this->parseString(NULL, local);
+        if (!str)
+            return EOF;
+        if (str == local)
+        {
+            *item = Value(local, strlen(local), NULL);
+            return 0;
+        }
+        // Heap copies belong to the value, anything else to the buffer or arena
+        *item = insitu || options.arena ? Value::borrowed(str) : Value::adopted(str);
+        return 0;
+    }
+    else if (in == '-' || (in >= '0' && in <= '9'))
+    {
+        return this->parseNumber(item);
+    }
+    else if (in == '[' || in == '{')
+    {
+        if (depth >= JSON_PARSE_MAX_DEPTH)
+            return EOF;
+        depth++;
+        int status = in == '[' ? this->parseArray(item, filter) : this->parseObject(item, filter);
+        depth--;
+        return status;
+    }
+    else if (in == 'n')
+    {
+        if (this->parseKeyword("null", 4))
+            return EOF;
+        *item = Value();
+        return 0;
+    }
+    else if (in == 'f')
+    {
+        if (this->parseKeyword("false", 5))
+            return EOF;
+        *item = false;
+        return 0;
+    }
+    else if (in == 't')
+    {
+        if (this->parseKeyword("true", 4))
+            return EOF;
+        *item = true;
+        return 0;
+    }
+    return EOF; // failure.
+}
+
+// Parse the string at p. In situ it is unescaped in place and terminated
+// where its closing quote was, otherwise it is unescaped into a copy from
+// owner's key pool, into local if it fits JSON_INLINE_SIZE, or from the
+// arena or heap for string values. Returns NULL if the string is malformed.
+char *BufferParser::parseString(Object *owner, char *local)
+{
+    if (p == end || *p != '\"')
+        return NULL; // not a string!
+    const char *start = ++p;
+    bool escaped = false;
+    while ((p = scanString(p, end)) < end && *p != '\"')
+    {
+        if (*p != '\\')
+            return NULL; // control character
+        escaped = true;
+        if (++p == end)
+            return NULL;
+        p++;
+    }
+    if (p == end)
+        return NULL; // unterminated
+    const char *close = p++;
+    char *out;
+    if (insitu)
+        out = (char *) start;
+    else if (owner)
+        out = owner->alloc_key(close - start + 1);
+    else if (local && (size_t) (close - start) < JSON_INLINE_SIZE)
+        out = local;
+    else
+        out = (char *) allocate(options.arena, close - start + 1);
+    if (!out)
+        return NULL;
+    char *out_end = out + (close - start);
+    if (escaped)
+        out_end = unescape(start, close, out);
+    else if (!insitu)
+        memcpy(out, start, close - start);
+    if (!out_end)
+    {
+        // Key pool space is reclaimed along with the object
+        if (!insitu && !owner && out != local)
+            release(options.arena, out, close - start + 1);
+        return NULL;
+    }
+    *out_end = 0;
+    // Heap strings are freed as strlen() + 1 bytes, so give back what the
+    // escapes saved; a \u0000 ends the string early
+    size_t length = escaped ? strlen(out) : 0;
+    if (escaped && !insitu && !owner && out != local && !options.arena && length < (size_t) (close - start))
+    {
+        char *shrunk = (char *) heapRealloc(out, close - start + 1, length + 1);
+        if (!shrunk)
+        {
+            heapFree(out, close - start + 1);
+            return NULL;
+        }
+        out = shrunk;
+    }
+    return out;
+}
+
+// Resolve the key at p against the key table without copying it first.
+// Only keys without escapes are tried; p is left alone if this fails.
+Key BufferParser::internKey()
+{
+    Key key = Key();
+    if (p == end || *p != '\"')
+        return key;
+    const char *close = scanString(p + 1, end);
+    if (close < end && *close == '\"')
+    {
+        key = options.keys->intern(p + 1, close - p - 1);
+        if (key.valid())
+            p = close + 1;
+    }
+    return key;
+}
+
+int BufferParser::parseNumber(Value *item)
+{
+    const char *next = readNumber(p, end, item);
+    if (!next)
+        return EOF;
+    p = next;
+    return 0;
+}
+
+// Consume a value without building it, for values a filter leaves out.
+// Strings and nesting are followed, scalars are taken up to the next
+// delimiter without checking them.
+int BufferParser::skipValue()
+{
+    int depth = 0;
+    do
+    {
+        int in = this->skip();
+        if (in == EOF)
+            return EOF;
+        p++;
+        if (in == '{' || in == '[')
+        {
+            depth++;
+        }
+        else if (in == '}' || in == ']')
+        {
+            depth--;
+        }
+        else if (in == ',' || in == ':')
+        {
+            if (depth == 0)
+                return EOF;
+        }
+        else if (in == '\"')
+        {
+            while ((p = scanString(p, end)) < end && *p != '\"')
+            {
+                if (*p == '\\' && ++p == end)
+                    return EOF;
+                p++;
+            }
+            if (p == end)
+                return EOF; // unterminated
+            p++;
+        }
+        else
+        {
+            while (p < end && (unsigned char) *p > 32 && *p != ',' && *p != ':' && *p != ']' && *p != '}')
+                p++;
+        }
+    } while (depth > 0);
+    return depth < 0 ? EOF : 0;
+}
+
+int BufferParser::parseArray(Value *item, const char *const *filter)
+{
+#ifdef JSON_STATS
+    StatsDepth nesting;
+#endif
+    p++; // '['
+    Array *array = create<Array>(options.arena);
+    if (!array)
+        return EOF;
+    *item = array;
+    if (options.arena)
+        item->flags |= JSON_FLAG_BORROWED;
+    if (this->skip() == ']')
+    {
+        p++;
+        return 0; // empty array.
+    }
+    int in;
+    int index = 0;
+    do
+    {
+        const char *children[JSON_FILTER_MAX + 1];
+        int match = filter ? narrowFilter(filter, NULL, 0, index++, children) : FILTER_ALL;
+        Value new_item = Value::invalid();
+        int status = match == FILTER_SKIP ? this->skipValue()
+                                          : this->parseValue(&new_item, match == FILTER_SOME ? children : NULL);
+        if (status)
+        {
+            new_item.free_parsed();
+            return EOF;
+        }
+        if (!new_item.isInvalid() && !array->append(new_item))
+        {
+            new_item.free_parsed();
+            return EOF;
+        }
+        in = this->skip();
+        p++;
+    } while (in == ',');
+    return in == ']' ? 0 : EOF;
+}
+
+int BufferParser::parseObject(Value *item, const char *const *filter)
+{
+#ifdef JSON_STATS
+    StatsDepth nesting;
+#endif
+    p++; // '{'
+    Object *object = create<Object>(options.arena);
+    if (!object)
+        return EOF;
+    *item = object;
+    if (options.arena)
+        item->flags |= JSON_FLAG_BORROWED;
+    if (this->skip() == '}')
+    {
+        p++;
+        return 0; // empty object.
+    }
+    int in;
+    do
+    {
+        this->skip();
+        const char *children[JSON_FILTER_MAX + 1];
+        int match = FILTER_ALL;
+        bool escaped = false;
+        if (filter)
+        {
+            // Match the raw key so skipped members allocate nothing; keys
+            // with escapes have to be decoded first
+            const char *close = p < end && *p == '\"' ? scanString(p + 1, end) : end;
+            escaped = close == end || *close != '\"';
+            if (!escaped && (match = narrowFilter(filter, p + 1, close - p - 1, -1, children)) == FILTER_SKIP)
+            {
+                p = close + 1;
+                if (this->skip() != ':' || (p++, this->skipValue()))
+                    return EOF;
+                in = this->skip();
+                p++;
+                continue;
+            }
+        }
+        Key interned = Key();
+        char *key = NULL;
+        if (options.keys)
+            interned = this->internKey();
+        if (!interned.valid() && !(key = this->parseString(object)))
+            return EOF;
+        if (escaped)
+        {
+            const char *name = interned.valid() ? interned.str : key;
+            match = narrowFilter(filter, name, strlen(name), -1, children);
+        }
+        // In situ keys live in the buffer, copies already are in the object
+        int key_mode = insitu ? AMAP_KEY_BORROW : AMAP_KEY_ADOPT;
+        Value value = Value::invalid();
+        if (this->skip() != ':')
+            return EOF;
+        p++;
+        int status = match == FILTER_SKIP ? this->skipValue()
+                                          : this->parseValue(&value, match == FILTER_SOME ? children : NULL);
+        if (status)
+        {
+            value.free_parsed();
+            return EOF;
+        }
+        if (value.isInvalid())
+        {
+            // filtered out
+            in = this->skip();
+            p++;
+            continue;
+        }
+        Value *slot = interned.valid() ? object->get_create(interned) : object->get_create(key, key_mode);
+        if (!slot)
+        {
+            value.free_parsed();
+            return EOF;
+        }
+        // A repeated key replaces the earlier value
+        slot->free_parsed();
+        *slot = value;
+        in = this->skip();
+        p++;
+    } while (in == ',');
+    return in == '}' ? 0 : EOF;
+}
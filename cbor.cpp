@@ -0,0 +1,431 @@
+#include <float.h>
+#include <math.h>
+#include "json.h"
+#include "writer.h"
+
+using namespace Json;
+
+// Major types, the top three bits of an initial byte
+#define CBOR_UNSIGNED 0
+#define CBOR_NEGATIVE 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_TAG 6
+#define CBOR_SIMPLE 7
+
+// Additional information, the low five bits
+#define CBOR_FALSE 20
+#define CBOR_TRUE 21
+#define CBOR_NULL 22
+#define CBOR_UNDEFINED 23
+#define CBOR_ARG8 24 // argument in the next 1, 2, 4 or 8 bytes
+#define CBOR_FLOAT16 25
+#define CBOR_FLOAT32 26
+#define CBOR_FLOAT64 27
+#define CBOR_INDEFINITE 31
+#define CBOR_BREAK 0xFF
+
+//Largest value json_int_t holds
+#define INT_LIMIT ((((uint64_t) 1) << (sizeof(json_int_t) * 8 - 1)) - 1)
+
+static void printCborValue(Value item, Writer &out);
+
+// Write an initial byte followed by bytes big endian bytes of argument.
+static void printCborArgument(uint8_t initial, int bytes, uint64_t argument, Writer &out)
+{
+    char *p = out.reserve(9);
+    *p++ = initial;
+    while (bytes--)
+        *p++ = argument >> (8 * bytes);
+    out.commit(p);
+}
+
+// Write a head in the shortest form that holds argument.
+static void printCborHead(uint8_t major, uint64_t argument, Writer &out)
+{
+    uint8_t initial = major << 5;
+    if (argument < CBOR_ARG8)
+        printCborArgument(initial | argument, 0, 0, out);
+    else if (argument <= 0xFF)
+        printCborArgument(initial | CBOR_ARG8, 1, argument, out);
+    else if (argument <= 0xFFFF)
+        printCborArgument(initial | (CBOR_ARG8 + 1), 2, argument, out);
+    else if (argument <= 0xFFFFFFFF)
+        printCborArgument(initial | (CBOR_ARG8 + 2), 4, argument, out);
+    else
+        printCborArgument(initial | (CBOR_ARG8 + 3), 8, argument, out);
+}
+
+static void printCborFloat(double d, Writer &out)
+{
+    float f = (float) d;
+    if ((double) f == d || d != d)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        printCborArgument(CBOR_SIMPLE << 5 | CBOR_FLOAT32, 4, bits, out);
+        return;
+    }
+#if DBL_MANT_DIG > 24
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    printCborArgument(CBOR_SIMPLE << 5 | CBOR_FLOAT64, 8, bits, out);
+#endif
+}
+
+static void printCborString(const char *str, Writer &out)
+{
+    size_t length = str ? strlen(str) : 0;
+    printCborHead(CBOR_TEXT, length, out);
+    out.put(str, length);
+}
+
+static void printCborValue(Value item, Writer &out)
+{
+    item.materialize();
+    switch (item.type)
+    {
+    case JSON_NULL:
+        printCborHead(CBOR_SIMPLE, CBOR_NULL, out);
+        break;
+    case JSON_BOOLEAN:
+        printCborHead(CBOR_SIMPLE, item.asBool() ? CBOR_TRUE : CBOR_FALSE, out);
+        break;
+    case JSON_INT:
+    {
+        json_int_t i = item.asInt64();
+        // Negative integers are sent as -1 - n
+        if (i < 0)
+            printCborHead(CBOR_NEGATIVE, (uint64_t) -(i + 1), out);
+        else
+            printCborHead(CBOR_UNSIGNED, i, out);
+        break;
+    }
+    case JSON_FLOAT:
+        printCborFloat(item.asDouble(), out);
+        break;
+    case JSON_STRING:
+        printCborString(item.asString(), out);
+        break;
+    case JSON_ARRAY:
+    {
+        Array &array = item.asArray();
+        printCborHead(CBOR_ARRAY, array.size(), out);
+        for (int i = 0; i < array.size(); i++)
+            printCborValue(array[i], out);
+        break;
+    }
+    case JSON_OBJECT:
+    {
+        Object &object = item.asObject();
+        // The head carries the count, so removed members are left out first
+        int count = 0;
+        for (int i = 0; i < object.size(); i++)
+            count += object.get(i).valid && !object.get(i).value.isInvalid();
+        printCborHead(CBOR_MAP, count, out);
+        for (int i = 0; i < object.size(); i++)
+        {
+            KeyValuePair<Value> kvp = object.get(i);
+            if (!kvp.valid || kvp.value.isInvalid())
+                continue;
+            printCborString(kvp.key, out);
+            printCborValue(kvp.value, out);
+        }
+        break;
+    }
+    }
+}
+
+int Json::printCbor(Value item, Print &print)
+{
+#ifdef JSON_STATS
+    StatsTimer timer(stats.print_micros);
+#endif
+    Writer out(print);
+    printCborValue(item, out);
+    out.flush();
+    return out.written;
+}
+
+Value Json::parseCbor(const uint8_t *buf, size_t len, const ParseOptions &options)
+{
+#ifdef JSON_STATS
+    StatsTimer timer(stats.parse_micros);
+#endif
+    aJsonStringStream stream(buf, len);
+    stream.options = options;
+    Value output;
+    if (stream.parseCbor(&output))
+    {
+        output.free_parsed();
+        return Value::invalid();
+    }
+    return output;
+}
+
+// Read an initial byte and its argument. Returns the additional
+// information, which tells indefinite lengths and floats apart, or EOF.
+int aJsonStream::readCborHead(int *major, uint64_t *argument)
+{
+    int in = this->getch();
+    if (in == EOF)
+        return EOF;
+    *major = in >> 5;
+    int info = in & 0x1F;
+    *argument = info;
+    if (info >= CBOR_ARG8 && info <= CBOR_FLOAT64)
+    {
+        uint8_t bytes[8];
+        size_t count = 1 << (info - CBOR_ARG8);
+        if (this->readBytes(bytes, count) != count)
+            return EOF;
+        *argument = 0;
+        for (size_t i = 0; i < count; i++)
+            *argument = (*argument << 8) | bytes[i];
+    }
+    else if (info > CBOR_FLOAT64 && info != CBOR_INDEFINITE)
+    {
+        return EOF; // reserved
+    }
+    return info;
+}
+
+// Decode an IEEE half or double from its bits, whatever size double is.
+static double cborFloat(int info, uint64_t bits)
+{
+    if (info == CBOR_FLOAT16)
+    {
+        int exponent = (bits >> 10) & 0x1F;
+        double mantissa = bits & 0x3FF;
+        double d;
+        if (exponent == 0)
+            d = ldexp(mantissa, -24);
+        else if (exponent != 31)
+            d = ldexp(mantissa + 1024, exponent - 25);
+        else
+            d = mantissa == 0 ? INFINITY : NAN;
+        return bits & 0x8000 ? -d : d;
+    }
+    if (info == CBOR_FLOAT32)
+    {
+        uint32_t bits32 = bits;
+        float f;
+        memcpy(&f, &bits32, sizeof(f));
+        return f;
+    }
+#if DBL_MANT_DIG > 24
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+#else
+    int exponent = (bits >> 52) & 0x7FF;
+    double mantissa = (double) (bits & 0xFFFFFFFFFFFFFULL);
+    double d;
+    if (exponent == 0)
+        d = ldexp(mantissa, -1074);
+    else if (exponent != 0x7FF)
+        d = ldexp(mantissa + 4503599627370496.0, exponent - 1075);
+    else
+        d = mantissa == 0 ? INFINITY : NAN;
+    return bits >> 63 ? -d : d;
+#endif
+}
+
+int aJsonStream::parseCbor(Value *item)
+{
+    return this->parseCborItem(item, 0);
+}
+
+// Read one item nested depth containers deep.
+int aJsonStream::parseCborItem(Value *item, int depth)
+{
+#ifdef JSON_STATS
+    stats.nodes++;
+#endif
+    int major;
+    uint64_t argument;
+    int info = this->readCborHead(&major, &argument);
+    // Tags only annotate the item that follows
+    while (info != EOF && major == CBOR_TAG && info != CBOR_INDEFINITE)
+        info = this->readCborHead(&major, &argument);
+    if (info == EOF)
+        return EOF;
+    // Only containers are read in indefinite form; a stray break is an error
+    if (info == CBOR_INDEFINITE && major != CBOR_ARRAY && major != CBOR_MAP)
+        return EOF;
+    switch (major)
+    {
+    case CBOR_UNSIGNED:
+        *item = argument <= INT_LIMIT ? Value((json_int_t) argument) : Value((double) argument);
+        return 0;
+    case CBOR_NEGATIVE:
+        *item = argument <= INT_LIMIT ? Value(-1 - (json_int_t) argument) : Value(-1.0 - (double) argument);
+        return 0;
+    case CBOR_TEXT:
+        return this->parseCborString(item, argument);
+    case CBOR_ARRAY:
+    case CBOR_MAP:
+        if (depth == JSON_CBOR_MAX_DEPTH)
+            return EOF;
+        if (major == CBOR_ARRAY)
+            return this->parseCborArray(item, info == CBOR_INDEFINITE, argument, depth + 1);
+        return this->parseCborMap(item, info == CBOR_INDEFINITE, argument, depth + 1);
+    case CBOR_SIMPLE:
+        break;
+    default:
+        // Byte strings have no JSON form
+        return EOF;
+    }
+    switch (info)
+    {
+    case CBOR_FALSE:
+        *item = false;
+        return 0;
+    case CBOR_TRUE:
+        *item = true;
+        return 0;
+    case CBOR_NULL:
+    case CBOR_UNDEFINED:
+        *item = Value();
+        return 0;
+    case CBOR_FLOAT16:
+    case CBOR_FLOAT32:
+    case CBOR_FLOAT64:
+        *item = Value(cborFloat(info, argument));
+        return 0;
+    default:
+        return EOF;
+    }
+}
+
+int aJsonStream::parseCborString(Value *item, uint64_t length)
+{
+    if (length >= (size_t) -1)
+        return EOF;
+    if (length < JSON_INLINE_SIZE)
+    {
+        // Short enough to live in the value
+        char local[JSON_INLINE_SIZE];
+        if (this->readBytes((uint8_t *) local, length) != length)
+            return EOF;
+        *item = Value(local, length, options.arena);
+        return 0;
+    }
+    // The length comes from the input, so grow the buffer only as bytes
+    // arrive rather than trusting it up front
+    char *buf = NULL;
+    size_t size = 0;
+    while (size < length)
+    {
+        size_t grown_size = size < 32 ? 64 : size * 2;
+        if (grown_size > length)
+            grown_size = length;
+        char *grown = (char *) reallocate(options.arena, buf, buf ? size + 1 : 0, grown_size + 1);
+        if (!grown || this->readBytes((uint8_t *) grown + size, grown_size - size) != grown_size - size)
+        {
+            release(options.arena, grown ? grown : buf, (grown ? grown_size : size) + 1);
+            return EOF;
+        }
+        buf = grown;
+        size = grown_size;
+    }
+    buf[length] = 0;
+    if (options.arena)
+    {
+        *item = Value::borrowed(buf);
+        return 0;
+    }
+    // Heap strings are freed as strlen() + 1 bytes, which a NUL shortens
+    size_t used = strlen(buf);
+    if (used < length)
+    {
+        char *shrunk = (char *) heapRealloc(buf, length + 1, used + 1);
+        if (!shrunk)
+        {
+            heapFree(buf, length + 1);
+            return EOF;
+        }
+        buf = shrunk;
+    }
+    *item = Value::adopted(buf);
+    return 0;
+}
+
+int aJsonStream::parseCborArray(Value *item, bool indefinite, uint64_t count, int depth)
+{
+#ifdef JSON_STATS
+    StatsDepth nesting;
+#endif
+    Array *array = create<Array>(options.arena);
+    if (!array)
+        return EOF;
+    *item = array;
+    if (options.arena)
+        item->flags |= JSON_FLAG_BORROWED;
+    for (uint64_t i = 0; indefinite || i < count; i++)
+    {
+        if (indefinite)
+        {
+            int in = this->getch();
+            if (in == CBOR_BREAK)
+                break;
+            if (in == EOF)
+                return EOF;
+            this->ungetch(in);
+        }
+        Value new_item;
+        if (this->parseCborItem(&new_item, depth) || !array->append(new_item))
+        {
+            new_item.free_parsed();
+            return EOF;
+        }
+    }
+    return 0;
+}
+
+int aJsonStream::parseCborMap(Value *item, bool indefinite, uint64_t count, int depth)
+{
+#ifdef JSON_STATS
+    StatsDepth nesting;
+#endif
+    Object *object = create<Object>(options.arena);
+    if (!object)
+        return EOF;
+    *item = object;
+    if (options.arena)
+        item->flags |= JSON_FLAG_BORROWED;
+    for (uint64_t i = 0; indefinite || i < count; i++)
+    {
+        int major;
+        uint64_t length;
+        int info = this->readCborHead(&major, &length);
+        if (indefinite && major == CBOR_SIMPLE && info == CBOR_INDEFINITE)
+            break;
+        // JSON keys are strings; they are read like the text parser's
+        if (info == EOF || info == CBOR_INDEFINITE || major != CBOR_TEXT || length >= STRING_BUFFER_LEN)
+            return EOF;
+        char key_name[STRING_BUFFER_LEN];
+        if (this->readBytes((uint8_t *) key_name, length) != length)
+            return EOF;
+        key_name[length] = 0;
+        Value value;
+        if (this->parseCborItem(&value, depth))
+        {
+            value.free_parsed();
+            return EOF;
+        }
+        Key interned = options.keys ? options.keys->intern(key_name, length) : Key();
+        Value *slot = interned.valid() ? object->get_create(interned) : object->get_create(key_name);
+        if (!slot)
+        {
+            value.free_parsed();
+            return EOF;
+        }
+        // A repeated key replaces the earlier value
+        slot->free_parsed();
+        *slot = value;
+    }
+    return 0;
+}
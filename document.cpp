@@ -0,0 +1,394 @@
+#include "json.h"
+#include "scan.h"
+#include "number.h"
+#include "document.h"
+
+using namespace Json;
+
+/* Tape entries keep a tag in the top byte and a 56 bit payload:
+ *   '[' '{'  element count << 32 | index of the matching close
+ *   ']' '}'  index of the matching open
+ *   '"' ':'  string value or object key: length << 32 | offset in strings
+ *   'l' 'd'  an integer or double, whose raw 64 bits are the next entry
+ *   'n' 't' 'f'
+ * The value of an object member has MEMBER set in its tag, so its key is
+ * the entry before it. */
+#define MEMBER 0x80
+#define TAG(entry) ((uint8_t)((entry) >> 56) & ~MEMBER)
+#define IS_MEMBER(entry) (((entry) >> 56) & MEMBER)
+#define PAYLOAD(entry) ((entry) & 0x00FFFFFFFFFFFFFFULL)
+#define LOW(entry) ((uint32_t)(entry))
+#define HIGH(entry) ((uint32_t)(PAYLOAD(entry) >> 32))
+
+//Largest count or string length a payload holds
+#define MAX_HIGH 0xFFFFFF
+
+// Builds the tape and string area in growing buffers, then packs them
+// into the document's single allocation.
+class TapeBuilder {
+public:
+    TapeBuilder(const char *json, size_t len)
+        : p(json), end(json + len), tape(NULL), tape_used(0), tape_size(0),
+          strings(NULL), strings_used(0), strings_size(0) {}
+    ~TapeBuilder() {
+        heapFree(tape, tape_size * sizeof(uint64_t));
+        heapFree(strings, strings_size);
+    }
+
+    // depth counts the containers open around the value
+    int parseValue(int depth);
+    bool atEnd() {
+        p = skipWhitespace(p, end);
+        return p == end;
+    }
+
+    const char *p;
+    const char *end;
+    uint64_t *tape;
+    size_t tape_used, tape_size;
+    char *strings;
+    size_t strings_used, strings_size;
+
+private:
+    int push(uint8_t tag, uint64_t payload);
+    int parseString(uint8_t tag);
+    int parseNumber();
+    int parseArray(int depth);
+    int parseObject(int depth);
+    int parseKeyword(const char *keyword, size_t len, uint8_t tag);
+};
+
+int TapeBuilder::push(uint8_t tag, uint64_t payload) {
+    if(tape_used == tape_size) {
+        size_t size = tape_size ? tape_size * 2 : 16;
+        uint64_t *grown = (uint64_t *)heapRealloc(tape, tape_size * sizeof(uint64_t), size * sizeof(uint64_t));
+        if(!grown)
+            return EOF;
+        tape = grown;
+        tape_size = size;
+    }
+    tape[tape_used++] = (uint64_t)tag << 56 | payload;
+    return 0;
+}
+
+int TapeBuilder::parseValue(int depth) {
+#ifdef JSON_STATS
+    stats.nodes++;
+#endif
+    p = skipWhitespace(p, end);
+    if(p == end)
+        return EOF;
+    switch(*p) {
+    case '\"':
+        return parseString('\"');
+    case '[':
+    case '{':
+        if(depth >= JSON_DOCUMENT_MAX_DEPTH)
+            return EOF;
+        return *p == '[' ? parseArray(depth + 1) : parseObject(depth + 1);
+    case 'n':
+        return parseKeyword("null", 4, 'n');
+    case 't':
+        return parseKeyword("true", 4, 't');
+    case 'f':
+        return parseKeyword("false", 5, 'f');
+    default:
+        return parseNumber();
+    }
+}
+
+int TapeBuilder::parseKeyword(const char *keyword, size_t len, uint8_t tag) {
+    if((size_t)(end - p) < len || memcmp(p, keyword, len))
+        return EOF;
+    p += len;
+    return push(tag, 0);
+}
+
+int TapeBuilder::parseNumber() {
+    Value number;
+    const char *next = readNumber(p, end, &number);
+    if(!next)
+        return EOF;
+    p = next;
+    uint64_t raw;
+    if(number.isInt()) {
+        raw = (uint64_t)(int64_t)number.asInt64();
+    }
+    else {
+        double d = number.asDouble();
+        raw = 0;
+        memcpy(&raw, &d, sizeof(d));
+    }
+    // The raw bits take the whole following entry
+    if(push(number.isInt() ? 'l' : 'd', 0) || push(0, 0))
+        return EOF;
+    tape[tape_used - 1] = raw;
+    return 0;
+}
+
+// Copy the string at p into the string area, unescaped and terminated.
+int TapeBuilder::parseString(uint8_t tag) {
+    const char *start = ++p;
+    bool escaped = false;
+    while((p = scanString(p, end)) < end && *p != '\"') {
+        if(*p != '\\' || ++p == end)
+            return EOF;
+        escaped = true;
+        p++;
+    }
+    if(p >= end)
+        return EOF;
+    size_t raw = p++ - start;
+    if(strings_used + raw + 1 > strings_size) {
+        size_t size = strings_size ? strings_size * 2 : 64;
+        while(size < strings_used + raw + 1)
+            size *= 2;
+        char *grown = (char *)heapRealloc(strings, strings_size, size);
+        if(!grown)
+            return EOF;
+        strings = grown;
+        strings_size = size;
+    }
+    char *out = strings + strings_used;
+    memcpy(out, start, raw);
+    char *out_end = escaped ? unescape(out, out + raw, out) : out + raw;
+    if(!out_end || (size_t)(out_end - out) > MAX_HIGH)
+        return EOF;
+    *out_end = 0;
+    uint64_t payload = (uint64_t)(out_end - out) << 32 | strings_used;
+    strings_used += out_end - out + 1;
+    return push(tag, payload);
+}
+
+int TapeBuilder::parseArray(int depth) {
+#ifdef JSON_STATS
+    StatsDepth nesting;
+#endif
+    p++; // '['
+    size_t open = tape_used;
+    if(push('[', 0))
+        return EOF;
+    uint32_t count = 0;
+    p = skipWhitespace(p, end);
+    if(p < end && *p == ']')
+        p++;
+    else {
+        for(;;) {
+            if(parseValue(depth))
+                return EOF;
+            count++;
+            p = skipWhitespace(p, end);
+            if(p == end)
+                return EOF;
+            if(*p++ == ']')
+                break;
+            if(p[-1] != ',')
+                return EOF;
+        }
+    }
+    if(push(']', open))
+        return EOF;
+    tape[open] |= (uint64_t)(count < MAX_HIGH ? count : MAX_HIGH) << 32 | (tape_used - 1);
+    return 0;
+}
+
+int TapeBuilder::parseObject(int depth) {
+#ifdef JSON_STATS
+    StatsDepth nesting;
+#endif
+    p++; // '{'
+    size_t open = tape_used;
+    if(push('{', 0))
+        return EOF;
+    uint32_t count = 0;
+    p = skipWhitespace(p, end);
+    if(p < end && *p == '}')
+        p++;
+    else {
+        for(;;) {
+            p = skipWhitespace(p, end);
+            if(p == end || *p != '\"' || parseString(':'))
+                return EOF;
+            p = skipWhitespace(p, end);
+            size_t value = tape_used;
+            if(p == end || *p++ != ':' || parseValue(depth))
+                return EOF;
+            tape[value] |= (uint64_t)MEMBER << 56;
+            count++;
+            p = skipWhitespace(p, end);
+            if(p == end)
+                return EOF;
+            if(*p++ == '}')
+                break;
+            if(p[-1] != ',')
+                return EOF;
+        }
+    }
+    if(push('}', open))
+        return EOF;
+    tape[open] |= (uint64_t)(count < MAX_HIGH ? count : MAX_HIGH) << 32 | (tape_used - 1);
+    return 0;
+}
+
+int Document::parse(const char *json, size_t len) {
+#ifdef JSON_STATS
+    StatsTimer timer(stats.parse_micros);
+    stats.bytes_parsed += len;
+#endif
+    heapFree(tape, bytes);
+    tape = NULL;
+    strings = NULL;
+    tape_length = bytes = 0;
+
+    TapeBuilder builder(json, len);
+    if(builder.parseValue(0) || !builder.atEnd() || builder.tape_used > 0xFFFFFFFF)
+        return EOF;
+    size_t tape_bytes = builder.tape_used * sizeof(uint64_t);
+    tape = (uint64_t *)heapAlloc(tape_bytes + builder.strings_used);
+    if(!tape)
+        return EOF;
+    memcpy(tape, builder.tape, tape_bytes);
+    char *string_area = (char *)tape + tape_bytes;
+    if(builder.strings_used)
+        memcpy(string_area, builder.strings, builder.strings_used);
+    strings = string_area;
+    tape_length = builder.tape_used;
+    bytes = tape_bytes + builder.strings_used;
+    return 0;
+}
+
+uint64_t Cursor::entry(uint32_t at) const {
+    return doc->tape[at];
+}
+
+// Tape index just past this value.
+uint32_t Cursor::after() const {
+    uint64_t e = entry(index);
+    switch(TAG(e)) {
+    case '[':
+    case '{':
+        return LOW(e) + 1;
+    case 'l':
+    case 'd':
+        return index + 2;
+    default:
+        return index + 1;
+    }
+}
+
+int Cursor::type() const {
+    if(!doc)
+        return JSON_INVALID;
+    switch(TAG(entry(index))) {
+    case 'n':
+        return JSON_NULL;
+    case 't':
+    case 'f':
+        return JSON_BOOLEAN;
+    case 'l':
+        return JSON_INT;
+    case 'd':
+        return JSON_FLOAT;
+    case '\"':
+        return JSON_STRING;
+    case '[':
+        return JSON_ARRAY;
+    case '{':
+        return JSON_OBJECT;
+    default:
+        return JSON_INVALID;
+    }
+}
+
+bool Cursor::asBool() const {
+    return doc && TAG(entry(index)) == 't';
+}
+
+json_int_t Cursor::asInt64() const {
+    if(!isInt())
+        return 0;
+    return (json_int_t)(int64_t)entry(index + 1);
+}
+
+double Cursor::asDouble() const {
+    if(!isFloat())
+        return 0.0;
+    uint64_t raw = entry(index + 1);
+    double d;
+    memcpy(&d, &raw, sizeof(d));
+    return d;
+}
+
+const char *Cursor::asString() const {
+    if(!isString())
+        return NULL;
+    return doc->strings + LOW(entry(index));
+}
+
+size_t Cursor::length() const {
+    return isString() ? HIGH(entry(index)) : 0;
+}
+
+int Cursor::size() const {
+    if(!isArray() && !isObject())
+        return 0;
+    uint32_t count = HIGH(entry(index));
+    if(count < MAX_HIGH)
+        return count;
+    // Too many to record; count them
+    count = 0;
+    for(Cursor c = first(); !c.isInvalid(); c = c.next())
+        count++;
+    return count;
+}
+
+Cursor Cursor::first() const {
+    if(!isArray() && !isObject())
+        return Cursor();
+    uint32_t at = index + 1;
+    uint8_t tag = TAG(entry(at));
+    if(tag == ']' || tag == '}')
+        return Cursor();
+    // Members start with their key
+    return Cursor(doc, tag == ':' ? at + 1 : at);
+}
+
+Cursor Cursor::next() const {
+    if(!doc)
+        return Cursor();
+    uint32_t at = after();
+    // The top level value has no siblings
+    if(at >= doc->tape_length)
+        return Cursor();
+    uint8_t tag = TAG(entry(at));
+    if(tag == ']' || tag == '}')
+        return Cursor();
+    return Cursor(doc, tag == ':' ? at + 1 : at);
+}
+
+const char *Cursor::key() const {
+    if(!doc || !IS_MEMBER(entry(index)))
+        return NULL;
+    return doc->strings + LOW(entry(index - 1));
+}
+
+Cursor Cursor::operator[](int i) const {
+    if(!isArray() || i < 0)
+        return Cursor();
+    Cursor c = first();
+    while(i-- > 0 && !c.isInvalid())
+        c = c.next();
+    return c;
+}
+
+Cursor Cursor::operator[](const char *key) const {
+    if(!isObject())
+        return Cursor();
+    size_t length = strlen(key);
+    for(Cursor c = first(); !c.isInvalid(); c = c.next()) {
+        uint64_t k = entry(c.index - 1);
+        if(HIGH(k) == length && memcmp(doc->strings + LOW(k), key, length) == 0)
+            return c;
+    }
+    return Cursor();
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "types.h"
+
+namespace Json {
+
+    class Document;
+
+    /* Read-only view of one value in a Document: a document pointer and a
+     * tape position, cheap to copy. Lookups on a missing member, a wrong
+     * type or past the end give an invalid cursor, which reads as empty. */
+    class Cursor {
+    public:
+        Cursor() : doc(NULL), index(0) {}
+
+        /* JSON_NULL to JSON_OBJECT, or JSON_INVALID. */
+        int type() const;
+        bool isInvalid() const { return doc == NULL; }
+        bool isNull() const { return type() == JSON_NULL; }
+        bool isBool() const { return type() == JSON_BOOLEAN; }
+        bool isInt() const { return type() == JSON_INT; }
+        bool isFloat() const { return type() == JSON_FLOAT; }
+        bool isString() const { return type() == JSON_STRING; }
+        bool isArray() const { return type() == JSON_ARRAY; }
+        bool isObject() const { return type() == JSON_OBJECT; }
+
+        bool asBool() const;
+        json_int_t asInt64() const;
+        int asInt() const { return asInt64(); }
+        double asDouble() const;
+        /* Points into the document's string area; NULL if not a string. */
+        const char *asString() const;
+        /* Length of a string, which may contain NUL bytes from \u0000. */
+        size_t length() const;
+
+        /* Elements of an array or members of an object. */
+        int size() const;
+        Cursor operator[](int i) const;
+        Cursor operator[](const char *key) const;
+        bool has(const char *key) const { return !(*this)[key].isInvalid(); }
+
+        /* Walk a container: first() is its first element or member value,
+         * next() the following sibling, with subtrees skipped in one step.
+         * Both are invalid at the end. */
+        Cursor first() const;
+        Cursor next() const;
+        /* For an object member value, the key it is stored under. */
+        const char *key() const;
+
+    private:
+        friend class Document;
+        Cursor(const Document *doc, uint32_t index) : doc(doc), index(index) {}
+        uint64_t entry(uint32_t at) const;
+        uint32_t after() const;
+
+        const Document *doc;
+        uint32_t index;
+    };
+
+    /* A parsed document stored flat: one tape of 8-byte entries, where
+     * containers record where they end so whole subtrees are skipped in
+     * O(1), followed by every string, all in a single allocation. Read it
+     * through root(); it cannot be modified. */
+    class Document {
+    public:
+        Document() : tape(NULL), strings(NULL), tape_length(0), bytes(0) {}
+        ~Document() { heapFree(tape, bytes); }
+
+        /* Replace the contents with json. Returns 0, or EOF if it is
+         * malformed or memory ran out, leaving the document empty. */
+        int parse(const char *json, size_t len);
+        int parse(const char *json) { return parse(json, strlen(json)); }
+
+        /* The top level value; invalid while the document is empty. */
+        Cursor root() const { return tape ? Cursor(this, 0) : Cursor(); }
+        /* Bytes held by the single allocation. */
+        size_t size() const { return bytes; }
+
+    private:
+        friend class Cursor;
+        Document(const Document &);
+        Document &operator=(const Document &);
+
+        uint64_t *tape;
+        const char *strings;
+        size_t tape_length;
+        size_t bytes;
+    };
+}
@@ -0,0 +1,333 @@
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+#include <pgmspace.h>
+#endif
+#include "json.h"
+#include "number.h"
+
+/* Grisu2 (Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+ * with Integers"): the shortest digit string that reads back as the same
+ * double in nearly all cases, and a correct round trip always. Works on
+ * whatever double is, so AVR's 32 bit double gets float length output. */
+
+using namespace Json;
+
+#if DBL_MANT_DIG > 24
+typedef uint64_t bits_t;
+#else
+typedef uint32_t bits_t;
+#endif
+
+// Target range for the binary exponent of the scaled value
+#define ALPHA -60
+#define GAMMA -32
+
+// A 64 bit significand and binary exponent: f * 2^e
+struct DiyFp
+{
+    uint64_t f;
+    int e;
+};
+
+static DiyFp diyFp(uint64_t f, int e)
+{
+    DiyFp x = { f, e };
+    return x;
+}
+
+static DiyFp sub(DiyFp x, DiyFp y)
+{
+    return diyFp(x.f - y.f, x.e);
+}
+
+// The upper half of the 128 bit product, rounded
+static DiyFp mul(DiyFp x, DiyFp y)
+{
+    uint64_t a = x.f >> 32, b = x.f & 0xFFFFFFFF;
+    uint64_t c = y.f >> 32, d = y.f & 0xFFFFFFFF;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t mid = (bd >> 32) + (ad & 0xFFFFFFFF) + (bc & 0xFFFFFFFF) + (1ULL << 31);
+    return diyFp(ac + (ad >> 32) + (bc >> 32) + (mid >> 32), x.e + y.e + 64);
+}
+
+static DiyFp normalize(DiyFp x)
+{
+    while (!(x.f >> 63))
+    {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+// 10^k as a normalized DiyFp, for k = -300, -292, ..., 324
+struct CachedPower
+{
+    uint64_t f;
+    int e;
+    int k;
+};
+
+static const CachedPower cached_powers[] PROGMEM = {
+    { 0xAB70FE17C79AC6CA, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4F, -1034, -292 },
+    { 0xBE5691EF416BD60C, -1007, -284 },
+    { 0x8DD01FAD907FFC3C,  -980, -276 },
+    { 0xD3515C2831559A83,  -954, -268 },
+    { 0x9D71AC8FADA6C9B5,  -927, -260 },
+    { 0xEA9C227723EE8BCB,  -901, -252 },
+    { 0xAECC49914078536D,  -874, -244 },
+    { 0x823C12795DB6CE57,  -847, -236 },
+    { 0xC21094364DFB5637,  -821, -228 },
+    { 0x9096EA6F3848984F,  -794, -220 },
+    { 0xD77485CB25823AC7,  -768, -212 },
+    { 0xA086CFCD97BF97F4,  -741, -204 },
+    { 0xEF340A98172AACE5,  -715, -196 },
+    { 0xB23867FB2A35B28E,  -688, -188 },
+    { 0x84C8D4DFD2C63F3B,  -661, -180 },
+    { 0xC5DD44271AD3CDBA,  -635, -172 },
+    { 0x936B9FCEBB25C996,  -608, -164 },
+    { 0xDBAC6C247D62A584,  -582, -156 },
+    { 0xA3AB66580D5FDAF6,  -555, -148 },
+    { 0xF3E2F893DEC3F126,  -529, -140 },
+    { 0xB5B5ADA8AAFF80B8,  -502, -132 },
+    { 0x87625F056C7C4A8B,  -475, -124 },
+    { 0xC9BCFF6034C13053,  -449, -116 },
+    { 0x964E858C91BA2655,  -422, -108 },
+    { 0xDFF9772470297EBD,  -396, -100 },
+    { 0xA6DFBD9FB8E5B88F,  -369,  -92 },
+    { 0xF8A95FCF88747D94,  -343,  -84 },
+    { 0xB94470938FA89BCF,  -316,  -76 },
+    { 0x8A08F0F8BF0F156B,  -289,  -68 },
+    { 0xCDB02555653131B6,  -263,  -60 },
+    { 0x993FE2C6D07B7FAC,  -236,  -52 },
+    { 0xE45C10C42A2B3B06,  -210,  -44 },
+    { 0xAA242499697392D3,  -183,  -36 },
+    { 0xFD87B5F28300CA0E,  -157,  -28 },
+    { 0xBCE5086492111AEB,  -130,  -20 },
+    { 0x8CBCCC096F5088CC,  -103,  -12 },
+    { 0xD1B71758E219652C,   -77,   -4 },
+    { 0x9C40000000000000,   -50,    4 },
+    { 0xE8D4A51000000000,   -24,   12 },
+    { 0xAD78EBC5AC620000,     3,   20 },
+    { 0x813F3978F8940984,    30,   28 },
+    { 0xC097CE7BC90715B3,    56,   36 },
+    { 0x8F7E32CE7BEA5C70,    83,   44 },
+    { 0xD5D238A4ABE98068,   109,   52 },
+    { 0x9F4F2726179A2245,   136,   60 },
+    { 0xED63A231D4C4FB27,   162,   68 },
+    { 0xB0DE65388CC8ADA8,   189,   76 },
+    { 0x83C7088E1AAB65DB,   216,   84 },
+    { 0xC45D1DF942711D9A,   242,   92 },
+    { 0x924D692CA61BE758,   269,  100 },
+    { 0xDA01EE641A708DEA,   295,  108 },
+    { 0xA26DA3999AEF774A,   322,  116 },
+    { 0xF209787BB47D6B85,   348,  124 },
+    { 0xB454E4A179DD1877,   375,  132 },
+    { 0x865B86925B9BC5C2,   402,  140 },
+    { 0xC83553C5C8965D3D,   428,  148 },
+    { 0x952AB45CFA97A0B3,   455,  156 },
+    { 0xDE469FBD99A05FE3,   481,  164 },
+    { 0xA59BC234DB398C25,   508,  172 },
+    { 0xF6C69A72A3989F5C,   534,  180 },
+    { 0xB7DCBF5354E9BECE,   561,  188 },
+    { 0x88FCF317F22241E2,   588,  196 },
+    { 0xCC20CE9BD35C78A5,   614,  204 },
+    { 0x98165AF37B2153DF,   641,  212 },
+    { 0xE2A0B5DC971F303A,   667,  220 },
+    { 0xA8D9D1535CE3B396,   694,  228 },
+    { 0xFB9B7CD9A4A7443C,   720,  236 },
+    { 0xBB764C4CA7A44410,   747,  244 },
+    { 0x8BAB8EEFB6409C1A,   774,  252 },
+    { 0xD01FEF10A657842C,   800,  260 },
+    { 0x9B10A4E5E9913129,   827,  268 },
+    { 0xE7109BFBA19C0C9D,   853,  276 },
+    { 0xAC2820D9623BF429,   880,  284 },
+    { 0x80444B5E7AA7CF85,   907,  292 },
+    { 0xBF21E44003ACDD2D,   933,  300 },
+    { 0x8E679C2F5E44FF8F,   960,  308 },
+    { 0xD433179D9C8CB841,   986,  316 },
+    { 0x9E19DB92B4E31BA9,  1013,  324 },
+};
+
+// A cached power c such that the binary exponent of w * c lands in
+// [ALPHA, GAMMA] for a normalized w with exponent e
+static CachedPower cachedPowerFor(int e)
+{
+    int f = ALPHA - e - 1;
+    int k = (f * 78913) / (1 << 18) + (f > 0); // ceil(f * log10(2))
+    int index = (300 + k + 7) / 8;
+    CachedPower power;
+    memcpy_P(&power, &cached_powers[index], sizeof(power));
+    return power;
+}
+
+// Number of decimal digits of n and the largest power of ten below it
+static int largestPow10(uint32_t n, uint32_t *pow10)
+{
+    int digits = 10;
+    *pow10 = 1000000000;
+    while (digits > 1 && n < *pow10)
+    {
+        *pow10 /= 10;
+        digits--;
+    }
+    return digits;
+}
+
+// Move the last digit towards w while the result stays inside the bounds
+static void roundWeed(char *buffer, int length, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t ten_k)
+{
+    while (rest < dist && delta - rest >= ten_k
+           && (rest + ten_k < dist || dist - rest > rest + ten_k - dist))
+    {
+        buffer[length - 1]--;
+        rest += ten_k;
+    }
+}
+
+// Generate the shortest digits of a value in (low, high) closest to w
+static int generateDigits(char *buffer, int *exponent, DiyFp low, DiyFp w, DiyFp high)
+{
+    uint64_t delta = sub(high, low).f;
+    uint64_t dist = sub(high, w).f;
+    DiyFp one = diyFp(1ULL << -high.e, high.e);
+    uint32_t p1 = (uint32_t) (high.f >> -one.e);
+    uint64_t p2 = high.f & (one.f - 1);
+    int length = 0;
+
+    uint32_t pow10;
+    for (int n = largestPow10(p1, &pow10); n > 0; n--)
+    {
+        buffer[length++] = '0' + p1 / pow10;
+        p1 %= pow10;
+        uint64_t rest = ((uint64_t) p1 << -one.e) + p2;
+        if (rest <= delta)
+        {
+            *exponent += n - 1;
+            roundWeed(buffer, length, dist, delta, rest, (uint64_t) pow10 << -one.e);
+            return length;
+        }
+        pow10 /= 10;
+    }
+    for (;;)
+    {
+        p2 *= 10;
+        buffer[length++] = '0' + (p2 >> -one.e);
+        p2 &= one.f - 1;
+        delta *= 10;
+        dist *= 10;
+        (*exponent)--;
+        if (p2 <= delta)
+            break;
+    }
+    roundWeed(buffer, length, dist, delta, p2, one.f);
+    return length;
+}
+
+// Shortest digits of positive, finite d, which is digits * 10^exponent
+static int grisu2(char *buffer, int *exponent, double d)
+{
+    const int precision = DBL_MANT_DIG;
+    const int bias = DBL_MAX_EXP - 1 + precision - 1;
+    const bits_t hidden = (bits_t) 1 << (precision - 1);
+    bits_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    bits_t E = bits >> (precision - 1);
+    bits_t F = bits & (hidden - 1);
+
+    DiyFp v = E == 0 ? diyFp(F, 1 - bias) : diyFp(F + hidden, (int) E - bias);
+    // The neighbours' midpoints; the lower one is closer at a power of two
+    DiyFp high = normalize(diyFp(2 * v.f + 1, v.e - 1));
+    DiyFp low = F == 0 && E > 1 ? diyFp(4 * v.f - 1, v.e - 2) : diyFp(2 * v.f - 1, v.e - 1);
+    low.f <<= low.e - high.e;
+    low.e = high.e;
+    v = normalize(v);
+
+    CachedPower power = cachedPowerFor(high.e);
+    DiyFp c = diyFp(power.f, power.e);
+    DiyFp w = mul(v, c);
+    DiyFp w_low = mul(low, c);
+    DiyFp w_high = mul(high, c);
+    // Stay strictly inside the bounds, whatever the rounding of mul()
+    w_low.f++;
+    w_high.f--;
+    *exponent = -power.k;
+    return generateDigits(buffer, exponent, w_low, w, w_high);
+}
+
+char *Json::writeDouble(char *out, double d)
+{
+    if (d != d || d > DBL_MAX || d < -DBL_MAX)
+    {
+        // JSON has no NaN or infinity
+        memcpy(out, "null", 4);
+        return out + 4;
+    }
+    if (signbit(d))
+    {
+        *out++ = '-';
+        d = -d;
+    }
+    if (d == 0)
+    {
+        memcpy(out, "0.0", 3);
+        return out + 3;
+    }
+    char digits[20];
+    int exponent;
+    int length = grisu2(digits, &exponent, d);
+    // Position of the decimal point relative to the first digit
+    int point = length + exponent;
+
+    if (point > 0 && point <= 15)
+    {
+        // 1234.5, or 1200.0 with the zeros spelt out
+        if (point >= length)
+        {
+            memcpy(out, digits, length);
+            memset(out + length, '0', point - length);
+            out += point;
+            memcpy(out, ".0", 2);
+            return out + 2;
+        }
+        memcpy(out, digits, point);
+        out[point] = '.';
+        memcpy(out + point + 1, digits + point, length - point);
+        return out + length + 1;
+    }
+    if (point <= 0 && point > -5)
+    {
+        // 0.00123
+        memcpy(out, "0.", 2);
+        memset(out + 2, '0', -point);
+        out += 2 - point;
+        memcpy(out, digits, length);
+        return out + length;
+    }
+    // 1.2345e-7
+    *out++ = digits[0];
+    if (length > 1)
+    {
+        *out++ = '.';
+        memcpy(out, digits + 1, length - 1);
+        out += length - 1;
+    }
+    *out++ = 'e';
+    int e = point - 1;
+    if (e < 0)
+    {
+        *out++ = '-';
+        e = -e;
+    }
+    if (e >= 100)
+        *out++ = '0' + e / 100;
+    if (e >= 10)
+        *out++ = '0' + e / 10 % 10;
+    *out++ = '0' + e % 10;
+    return out;
+}
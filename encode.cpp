@@ -1,11 +1,13 @@
 #include "json.h"
+#include "scan.h"
+#include "number.h"
+#include "writer.h"
 
-#define FLOAT_PRECISION 5
+using namespace Json;
 
-int printFloat(double d, Print *print);
-int printStringPtr(const char *str, Print *print);
-int printArray(Json::Array &value, Print *print);
-int printObject(Json::Object &value, Print *print);
+static void printValue(Json::Value item, Writer &out);
+static void printArray(Json::Array &value, Writer &out);
+static void printObject(Json::Object &value, Writer &out);
 
 class JsonDumper : public Print {
 public:
@@ -25,15 +27,97 @@ public:
     }
     return ret;
   }
+  virtual size_t write(const uint8_t *data, size_t length) {
+    if(length > size)
+      length = size;
+    memcpy(buffer, data, length);
+    buffer += length;
+    size -= length;
+    return length;
+  }
 };
 
 int Json::dump(Json::Value value, char* out, size_t size) {
-  JsonDumper stream(out, size);
+  if(size == 0)
+    return 0;
+  // Keep the last byte for the terminator
+  JsonDumper stream(out, size - 1);
   int length = Json::print(value, stream);
-  if(length > 0) out[length] = 0;
+  out[length] = 0;
   return length;
 }
 
+char *Json::dumpToString(Json::Value value, size_t *length) {
+  DynamicBuffer buffer;
+  Json::print(value, buffer);
+  if(length)
+    *length = buffer.length();
+  // Hand over even an empty buffer so the caller always gets a string
+  if(buffer.failed() || !buffer.reserve(1))
+    return NULL;
+  return buffer.release();
+}
+
+DynamicBuffer::DynamicBuffer(size_t capacity, Arena *arena)
+  : data(NULL), _length(0), _capacity(0), _failed(false), arena(arena) {
+  if(capacity)
+    reserve(capacity);
+}
+
+DynamicBuffer::~DynamicBuffer() {
+  if(!arena)
+    free(data);
+}
+
+bool DynamicBuffer::reserve(size_t capacity) {
+  if(capacity <= _capacity && data)
+    return true;
+  // One more for the terminator. Plain heap rather than the library's, as
+  // release() hands the block to the caller to free()
+  char *grown = arena ? (char *)arena->realloc(data, data ? _capacity + 1 : 0, capacity + 1)
+                      : (char *)realloc(data, capacity + 1);
+  if(!grown)
+    return false;
+  grown[_length] = 0;
+  data = grown;
+  _capacity = capacity;
+  return true;
+}
+
+size_t DynamicBuffer::write(uint8_t ch) {
+  return write(&ch, 1);
+}
+
+size_t DynamicBuffer::write(const uint8_t *buffer, size_t size) {
+  if(_length + size > _capacity) {
+    size_t capacity = _capacity ? _capacity * 2 : 64;
+    while(capacity < _length + size)
+      capacity *= 2;
+    if(!reserve(capacity)) {
+      _failed = true;
+      return 0;
+    }
+  }
+  memcpy(data + _length, buffer, size);
+  _length += size;
+  data[_length] = 0;
+  return size;
+}
+
+void DynamicBuffer::clear() {
+  _length = 0;
+  _failed = false;
+  if(data)
+    data[0] = 0;
+}
+
+char *DynamicBuffer::release() {
+  char *output = data;
+  data = NULL;
+  _length = _capacity = 0;
+  return output;
+}
+
 
 int Json::println(Value v, Print &p) { int result = 0;
   result += print(v, p);
@@ -44,154 +128,166 @@ int Json::println(Value v, Print &p) { int result = 0;
 // Render a value to text.
 int Json::print(Value item, Print &print)
 {
-  int result = 0;
+#ifdef JSON_STATS
+  StatsTimer timer(stats.print_micros);
+#endif
+  Writer out(print);
+  printValue(item, out);
+  out.flush();
+  return out.written;
+}
+
+static void printValue(Json::Value item, Writer &out)
+{
   switch (item.type)
   {
     case JSON_NULL:
-      result = print.print("null");
+      out.put("null", 4);
       break;
     case JSON_BOOLEAN:
       if(item.asBool()){
-        result = print.print("true");
+        out.put("true", 4);
       }
       else{
-        result = print.print("false");
+        out.put("false", 5);
       }
       break;
     case JSON_INT:
-      result = print.print(item.asInt());
+      printInt(item.asInt64(), out);
       break;
     case JSON_FLOAT:
-      result = printFloat(item.asFloat(), &print);
+      printFloat(item.asDouble(), out);
       break;
     case JSON_STRING:
-      result = printStringPtr(item.asString(), &print);
+      printStringPtr(item.asString(), out);
       break;
     case JSON_ARRAY:
-      result = printArray(item.asArray(), &print);
+      printArray(item.asArray(), out);
       break;
     case JSON_OBJECT:
-      result = printObject(item.asObject(), &print);
+      printObject(item.asObject(), out);
+      break;
+    case JSON_LAZY:
+    {
+      // Unparsed text is already JSON
+      size_t length;
+      const char *text = item.lazyText(&length);
+      if (text) {
+        out.put(text, length);
+      }
+      else {
+        item.materialize();
+        printValue(item, out);
+      }
       break;
+    }
   }
-  return result;
 }
 
-int printFloat(double d, Print *print)
+// Format integers straight into the chunk; Print has no overload for
+// every json_int_t width anyway.
+void Json::printInt(json_int_t i, Writer &out)
 {
-  int result = 0;
-  if (d<0.0) {
-    print->print("-");
-    d=-d;
-  }
-  //print the integer part
-  unsigned long integer_number = (unsigned long)d;
-  result += print->print(integer_number, DEC);
-  result += print->print(".");
-  //print the fractional part
-  double fractional_part = d - ((double)integer_number);
-  //we do a do-while since we want to print at least one zero
-  //we just support a certain number of digits after the '.'
-  int n = FLOAT_PRECISION;
-  fractional_part += 0.5/pow(10.0, FLOAT_PRECISION);
+  char digits[3 * sizeof(json_int_t) + 2];
+  char *p = digits + sizeof(digits);
+  // Negate as unsigned so the most negative value survives
+  unsigned long long n = i < 0 ? 0ULL - (unsigned long long)i : (unsigned long long)i;
   do {
-    //make the first digit non fractional(shift it before the '.'
-    fractional_part *= 10.0;
-    //create an int out of it
-    unsigned int digit = (unsigned int) fractional_part;
-    //print it
-    result += print->print(digit, DEC);
-    //remove it from the number
-    fractional_part -= (double)digit;
-    n--;
-  } while ((fractional_part!=0) && (n>0));
-  return result;
+    *--p = '0' + n % 10;
+    n /= 10;
+  } while (n);
+  if (i < 0)
+    *--p = '-';
+  out.put(p, digits + sizeof(digits) - p);
+}
+
+void Json::printFloat(double d, Writer &out)
+{
+  out.commit(Json::writeDouble(out.reserve(JSON_DOUBLE_LEN), d));
 }
 
 // Render the cstring provided to an escaped version that can be printed.
-int printStringPtr(const char *str, Print *print)
+void Json::printStringPtr(const char *str, Writer &out)
 {
-  int result = 0;
-  result += print->print("\"");
-  char* ptr = (char*) str;
+  out.put('\"');
+  const char* ptr = str;
   if (ptr != NULL)
   {
     while (*ptr != 0)
     {
-      if ((unsigned char) *ptr > 31 && *ptr != '\"' && *ptr != '\\')
+      // Copy the run up to the next character that needs escaping at once
+      const char *special = Json::scanEscape(ptr);
+      if (special != ptr)
       {
-        result += print->print(*ptr);
-        ptr++;
+        out.put(ptr, special - ptr);
+        ptr = special;
+        continue;
       }
-      else
+      char escape;
+      switch (*ptr++)
       {
-        result += 2;
-        print->print('\\');
-        switch (*ptr++)
-        {
-        case '\\':
-          print->print('\\');
-          break;
-        case '\"':
-          print->print('\"');
-          break;
-        case '/':
-          print->print('/');
-          break;
-        case '\b':
-          print->print('b');
-          break;
-        case '\f':
-          print->print('f');
-          break;
-        case '\n':
-          print->print('n');
-          break;
-        case '\r':
-          print->print('r');
-          break;
-        case '\t':
-          print->print('t');
-          break;
-        default:
-          break; // eviscerate with prejudice.
-        }
+      case '\\':
+        escape = '\\';
+        break;
+      case '\"':
+        escape = '\"';
+        break;
+      case '/':
+        escape = '/';
+        break;
+      case '\b':
+        escape = 'b';
+        break;
+      case '\f':
+        escape = 'f';
+        break;
+      case '\n':
+        escape = 'n';
+        break;
+      case '\r':
+        escape = 'r';
+        break;
+      case '\t':
+        escape = 't';
+        break;
+      default:
+        continue; // eviscerate with prejudice.
       }
-
+      out.put('\\');
+      out.put(escape);
     }
   }
-  result += print->print('\"');
-  return result;
+  out.put('\"');
 }
+
 // Render an array to text
-int printArray(Json::Array &value, Print *print)
+static void printArray(Json::Array &value, Writer &out)
 {
-  int result = 0;
-  result += print->print('[');
+  out.put('[');
   for(int i = 0; i < value.size(); i++) {
-    result += Json::print(value[i], *print);
+    printValue(value[i], out);
     if(i < value.size() - 1)
-      result += print->print(',');
+      out.put(',');
   }
-  result += print->print(']');
-  return result;
+  out.put(']');
 }
 
 // Render an object to text.
-int printObject(Json::Object &value, Print *print)
+static void printObject(Json::Object &value, Writer &out)
 {
-  int result = 0;
-  result += print->print('{');
+  bool first = true;
+  out.put('{');
   for(int i = 0; i < value.size(); i++) {
     KeyValuePair<Json::Value> kvp = value.get(i);
-    if(kvp.value.isInvalid())
+    // Removed in keep_order mode, or a slot nothing was stored in
+    if(!kvp.valid || kvp.value.isInvalid())
       continue;
-    if(i > 0)
-      result += print->print(',');
-    result += printStringPtr(kvp.key, print);
-    result += print->print(':');
-    result += Json::print(kvp.value, *print);
+    if(!first)
+      out.put(',');
+    first = false;
+    printStringPtr(kvp.key, out);
+    out.put(':');
+    printValue(kvp.value, out);
   }
-  result += print->print("}");
-  return result;
-}
\ No newline at end of file
+  out.put('}');
+}
@@ -0,0 +1,52 @@
+#include <string.h>
+#include "filter.h"
+
+using namespace Json;
+
+// Match the first segment of path against an object key, or an array index
+// when key is NULL. Returns what follows the segment, or NULL.
+static const char *matchSegment(const char *path, const char *key, size_t length, int index) {
+    if(key) {
+        if(*path == '[' || strncmp(path, key, length))
+            return NULL;
+        path += length;
+        //Only a prefix of the segment
+        if(*path != 0 && *path != '.' && *path != '[')
+            return NULL;
+    }
+    else {
+        if(*path++ != '[')
+            return NULL;
+        if(*path == '*')
+            path++;
+        else {
+            if(*path < '0' || *path > '9')
+                return NULL;
+            int n = 0;
+            while(*path >= '0' && *path <= '9')
+                n = n * 10 + (*path++ - '0');
+            if(n != index)
+                return NULL;
+        }
+        if(*path++ != ']')
+            return NULL;
+    }
+    if(*path == '.')
+        path++;
+    return path;
+}
+
+int Json::narrowFilter(const char *const *filter, const char *key, size_t length,
+                       int index, const char *children[JSON_FILTER_MAX + 1]) {
+    int count = 0;
+    for(int i = 0; filter[i] && i < JSON_FILTER_MAX; i++) {
+        const char *rest = matchSegment(filter[i], key, length, index);
+        if(!rest)
+            continue;
+        if(*rest == 0)
+            return FILTER_ALL;
+        children[count++] = rest;
+    }
+    children[count] = NULL;
+    return count ? FILTER_SOME : FILTER_SKIP;
+}
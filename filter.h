@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+
+/* Path filters for the filter argument of the parse functions.
+ *
+ * A filter is a NULL terminated list of key paths such as "meta.id",
+ * "sensors[*].temp" or "[0].name": object keys separated by dots, array
+ * indices or [*] in brackets. Only values on one of the paths are built;
+ * everything else is skipped without allocating. Containers along a path
+ * are kept even if nothing under them matched, and keys containing '.'
+ * or '[' cannot be selected. */
+
+//Most paths a single filter can hold
+#ifndef JSON_FILTER_MAX
+#define JSON_FILTER_MAX 8
+#endif
+
+//Results of narrowFilter
+#define FILTER_SKIP 0 // no path goes through this member
+#define FILTER_SOME 1 // parse the member with the narrowed filter
+#define FILTER_ALL 2  // a path ends here, parse the member in full
+
+namespace Json {
+
+    /* Narrow filter to the object member called key, or to array element
+     * index when key is NULL, writing the remaining paths to children. */
+    int narrowFilter(const char *const *filter, const char *key, size_t length,
+                     int index, const char *children[JSON_FILTER_MAX + 1]);
+}
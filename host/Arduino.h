@@ -0,0 +1,15 @@
+// Host stand-ins for the parts of the Arduino core the library uses, so
+// it builds and runs natively; see CMakeLists.txt.
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "WString.h"
+#include "Print.h"
+
+unsigned long millis();
+unsigned long micros();
+
+char *itoa(int value, char *str, int base);
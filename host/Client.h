@@ -0,0 +1,12 @@
+// Host stand-in for the Arduino Client class.
+#pragma once
+
+#include "Stream.h"
+
+class Client : public Stream {
+public:
+    virtual int connect(const char *host, uint16_t port) = 0;
+    virtual uint8_t connected() = 0;
+    virtual void stop() = 0;
+    virtual operator bool() = 0;
+};
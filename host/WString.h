@@ -0,0 +1,33 @@
+// Host stand-in for the Arduino String class, just what Json::Value needs.
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+
+class String {
+public:
+    String(const char *s = "") { assign(s, strlen(s)); }
+    String(const String &o) { assign(o.buf, o.len); }
+    ~String() { free(buf); }
+    String &operator=(const String &o) {
+        if(this != &o) { free(buf); assign(o.buf, o.len); }
+        return *this;
+    }
+    unsigned int length() const { return len; }
+    const char *c_str() const { return buf; }
+    void toCharArray(char *out, unsigned int size) const {
+        if(!size) return;
+        unsigned int n = len < size - 1 ? len : size - 1;
+        memcpy(out, buf, n);
+        out[n] = 0;
+    }
+private:
+    void assign(const char *s, unsigned int n) {
+        buf = (char*)malloc(n + 1);
+        memcpy(buf, s, n);
+        buf[n] = 0;
+        len = n;
+    }
+    char *buf;
+    unsigned int len;
+};
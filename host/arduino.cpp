@@ -0,0 +1,26 @@
+// Host implementations of the Arduino functions declared in Arduino.h.
+#include "Arduino.h"
+#include <stdio.h>
+#include <time.h>
+
+static unsigned long long monotonic_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+unsigned long millis() { return (unsigned long)(monotonic_us() / 1000); }
+unsigned long micros() { return (unsigned long)monotonic_us(); }
+
+char *itoa(int value, char *str, int base) {
+    if(base == 10) sprintf(str, "%d", value);
+    else if(base == 16) sprintf(str, "%x", value);
+    else sprintf(str, "%o", value);
+    return str;
+}
+
+size_t Print::print(double n, int digits) {
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "%.*f", digits, n);
+    return write(buf, len);
+}
@@ -0,0 +1,6 @@
+// Host stand-in for pgmspace.h: program memory is ordinary memory.
+#pragma once
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const unsigned char *)(addr))
+#define memcpy_P memcpy
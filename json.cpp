@@ -42,6 +42,7 @@
 #include <pgmspace.h>
 #endif
 #include "json.h"
+#include "number.h"
 
 /******************************************************************************
  * Definitions
@@ -49,39 +50,150 @@
 //Default buffer sizes - buffers get initialized and grow acc to that size
 #define BUFFER_DEFAULT_SIZE 4
 
-//how much digits after . for float
-#define FLOAT_PRECISION 5
-
 using namespace Json;
 
+// Replace value, taken from a source container, with what its copy holds.
+// Strings are always copied, and so are containers unless share is set.
+// Containers owned by an arena or a LazyDocument are copied either way,
+// since the copy may outlive them. Returns false, leaving value alone,
+// without memory for the copy.
+static bool copyValue(Value &value, bool share) {
+    Value source = value;
+    source.materialize();
+    Value copy = source;
+    if(source.type == JSON_ARRAY || source.type == JSON_OBJECT) {
+        uint16_t *shares = source.type == JSON_ARRAY ? &source.asArray().shares : &source.asObject().shares;
+        if(share && !(source.flags & JSON_FLAG_BORROWED) && *shares < 0xFFFF)
+            (*shares)++;
+        else if(source.type == JSON_ARRAY) {
+            Array *array = share ? source.asArray().share() : source.asArray().clone();
+            if(!array)
+                return false;
+            copy = Value(array);
+        }
+        else {
+            Object *object = share ? source.asObject().share() : source.asObject().clone();
+            if(!object)
+                return false;
+            copy = Value(object);
+        }
+    }
+    else if(source.isString()) {
+        copy = Value(source.asString());
+        if(copy.isInvalid())
+            return false;
+    }
+    value = copy;
+    return true;
+}
+
+// Swap a shared container in slot for a copy of its own, giving up the
+// share. Returns false, leaving it shared, without memory for the copy.
+static bool detach(Value &slot) {
+    if(slot.type == JSON_OBJECT && slot.asObject().shares) {
+        Object *copy = slot.asObject().share();
+        if(!copy)
+            return false;
+        slot.asObject().shares--;
+        slot = Value(copy);
+    }
+    else if(slot.type == JSON_ARRAY && slot.asArray().shares) {
+        Array *copy = slot.asArray().share();
+        if(!copy)
+            return false;
+        slot.asArray().shares--;
+        slot = Value(copy);
+    }
+    return true;
+}
+
 Object *Object::clone() {
+    return duplicate(false);
+}
+Object *Object::share() {
+    return duplicate(true);
+}
+Object *Object::duplicate(bool share) {
     Object *copy = new Object(*this);
-    for(auto &kvp : *this) {
-        if(kvp.value.isArray())
-            kvp.value = *kvp.value.asArray().clone();
-        if(kvp.value.isObject())
-            kvp.value = *kvp.value.asObject().clone();
-        if(kvp.value.isString())
-            kvp.value = kvp.value.asString();
+    if(!copy)
+        return NULL;
+    // A copy that ran out of memory is left without elements
+    bool failed = !copy->elements;
+    for(auto &kvp : *copy) {
+        failed = failed || !copyValue(kvp.value, share);
+        // Values still the source's must not be freed with the copy
+        if(failed)
+            kvp.value = Value();
+    }
+    if(failed) {
+        delete copy;
+        return NULL;
     }
     return copy;
 }
+Value *Object::edit(const char *key) {
+    Value *slot = get(key);
+    return slot && detach(*slot) ? slot : NULL;
+}
 Json::Value Object::default_init() {
     return Value::invalid();
 }
+void Object::free_value(Value &value) {
+    value.free_parsed();
+}
 
 Array *Array::clone() {
+    return duplicate(false);
+}
+Array *Array::share() {
+    return duplicate(true);
+}
+Array *Array::duplicate(bool share) {
     Array *copy = new Array(*this);
-    for(auto &kvp : *this) {
-        if(kvp.isArray())
-            kvp = *kvp.asArray().clone();
-        if(kvp.isObject())
-            kvp = *kvp.asObject().clone();
-        if(kvp.isString())
-            kvp = kvp.asString();
+    if(!copy)
+        return NULL;
+    bool failed = !copy->elements;
+    for(auto &item : *copy) {
+        failed = failed || !copyValue(item, share);
+        if(failed)
+            item = Value();
+    }
+    if(failed) {
+        delete copy;
+        return NULL;
     }
     return copy;
 }
+Value *Array::edit(int i) {
+    if(i < 0 || i >= size())
+        return NULL;
+    return detach(get(i)) ? &get(i) : NULL;
+}
+
+bool Object::set(const char *key, OwnedValue &&value) {
+    Value *slot = get_create(key);
+    if(!slot)
+        return false;
+    slot->free_parsed();
+    *slot = value.release();
+    return true;
+}
+
+bool Object::set(const Key &key, OwnedValue &&value) {
+    Value *slot = get_create(key);
+    if(!slot)
+        return false;
+    slot->free_parsed();
+    *slot = value.release();
+    return true;
+}
+
+bool Array::append(OwnedValue &&value) {
+    if(!append(value.get()))
+        return false;
+    value.release();
+    return true;
+}
 Object::~Object() {
     for(auto kvp : (*this)) {
             kvp.value.free_parsed();
@@ -95,7 +207,9 @@ Array::~Array() {
 
 class JsonMeasurer : public Print {
 public:
+    JsonMeasurer() : _length(0) {}
     size_t write(uint8_t ch) { _length += 1; return 1; }
+    size_t write(const uint8_t *buffer, size_t size) { _length += size; return size; }
     size_t length() { return _length; }
 private:
     size_t _length;
@@ -140,13 +254,17 @@ aJsonStream::getch()
     // stream()->available() forever, hence the 500ms timeout.
     unsigned long i= millis()+500;
     while ((!stream()->available()) && (millis() < i)) /* spin with a timeout*/;
+#ifdef JSON_STATS
+    stats.bytes_parsed++;
+#endif
     return stream()->read();
 }
 
 void
 aJsonStream::ungetch(char ch)
 {
-    bucket = ch;
+    // as getch() returned it, so bytes above 0x7F do not turn negative
+    bucket = (unsigned char) ch;
 }
 
 size_t
@@ -155,6 +273,12 @@ aJsonStream::write(uint8_t ch)
     return stream()->write(ch);
 }
 
+size_t
+aJsonStream::write(const uint8_t *buffer, size_t size)
+{
+    return stream()->write(buffer, size);
+}
+
 size_t
 aJsonStream::readBytes(uint8_t *buffer, size_t len)
 {
@@ -186,6 +310,9 @@ aJsonClientStream::getch()
             stream()->stop();
             return EOF;
         }
+#ifdef JSON_STATS
+    stats.bytes_parsed++;
+#endif
     return stream()->read();
 }
 
@@ -210,8 +337,12 @@ aJsonStringStream::getch()
     {
         return EOF;
     }
-    char ch = *inbuf++;
+    // Unsigned, or UTF-8 bytes would read as negative and 0xFF as EOF
+    unsigned char ch = *inbuf++;
     inbuf_len--;
+#ifdef JSON_STATS
+    stats.bytes_parsed++;
+#endif
     return ch;
 }
 
@@ -227,83 +358,40 @@ aJsonStringStream::write(uint8_t ch)
     return 1;
 }
 
+size_t
+aJsonStringStream::write(const uint8_t *buffer, size_t size)
+{
+    if (!outbuf || outbuf_len <= 1)
+    {
+        return 0;
+    }
+    //keep room for the terminator, like write(uint8_t)
+    if (size > outbuf_len - 1)
+        size = outbuf_len - 1;
+    memcpy(outbuf, buffer, size);
+    outbuf += size; outbuf_len -= size;
+    *outbuf = 0;
+    return size;
+}
+
 // Parse the input text to generate a number, and populate the result into item.
 int aJsonStream::parseNumber(Value *item)
 {
-    int i = 0;
-    int sign = 1;
-
+    // Collect the characters a number can contain, then convert them
+    char buffer[JSON_NUMBER_LEN];
+    size_t length = 0;
     int in = this->getch();
-    if (in == EOF)
+    while ((in >= '0' && in <= '9') || in == '-' || in == '+' || in == '.' || in == 'e' || in == 'E')
     {
-        return EOF;
-    }
-    // It is easier to decode ourselves than to use sscnaf,
-    // since so we can easier decide between int & double
-    if (in == '-')
-    {
-        //it is a negative number
-        sign = -1;
-        in = this->getch();
-        if (in == EOF)
-        {
+        if (length == sizeof(buffer))
             return EOF;
-        }
-    }
-    if (in >= '0' && in <= '9') {
-        do
-        {
-            i = (i * 10) + (in - '0');
-            in = this->getch();
-        }
-        while (in >= '0' && in <= '9'); // Number?
-    }
-    //end of integer part � or isn't it?
-    if (!(in == '.' || in == 'e' || in == 'E'))
-    {
-        *item = Value(i * (int) sign);
-    }
-    //ok it seems to be a double
-    else
-    {
-        double n = (double) i;
-        int scale = 0;
-        int subscale = 0;
-        char signsubscale = 1;
-        if (in == '.')
-        {
-            in = this->getch();
-            do
-            {
-                n = (n * 10.0) + (in - '0'), scale--;
-                in = this->getch();
-            }
-            while (in >= '0' && in <= '9');
-        } // Fractional part?
-        if (in == 'e' || in == 'E') // Exponent?
-        {
-            in = this->getch();
-            if (in == '+')
-            {
-                in = this->getch();
-            }
-            else if (in == '-')
-            {
-                signsubscale = -1;
-                in = this->getch();
-            }
-            while (in >= '0' && in <= '9')
-            {
-                subscale = (subscale * 10) + (in - '0'); // Number?
-                in = this->getch();
-            }
-        }
-
-        n = sign * n * pow(10.0, ((double) scale + (double) subscale
-                * (double) signsubscale)); // number = +/- number.fraction * 10^+/- exponent
-        *item = Value(float(n));
+        buffer[length++] = in;
+        in = this->getch();
     }
     //preserve the last character for the next routine
-    this->ungetch(in);
+    if (in != EOF)
+        this->ungetch(in);
+    if (readNumber(buffer, buffer + length, item) != buffer + length)
+        return EOF;
     return 0;
 }
\ No newline at end of file
@@ -29,21 +29,164 @@ THE SOFTWARE.
 #include <Client.h>
 #include <Arduino.h>  // To get access to the Arduino millis() function
 #include "types.h"
+#include "filter.h"
+#include "path.h"
+#include "document.h"
 
 #ifndef EOF
 #define EOF -1
 #endif
 
+//Chunk the encoder collects output in before writing it to the Print
+#ifndef PRINT_BUFFER_LEN
+#ifdef __AVR__
+#define PRINT_BUFFER_LEN 32
+#else
 #define PRINT_BUFFER_LEN 256
+#endif
+#endif
+//Longest string the stream parser can read, plus one
+#define STRING_BUFFER_LEN 256
+
+//Events returned by aJsonStream::nextToken()
+#define JSON_TOKEN_ERROR EOF
+#define JSON_TOKEN_END 0 // the document is complete
+#define JSON_TOKEN_START_OBJECT 1
+#define JSON_TOKEN_END_OBJECT 2
+#define JSON_TOKEN_START_ARRAY 3
+#define JSON_TOKEN_END_ARRAY 4
+#define JSON_TOKEN_KEY 5
+#define JSON_TOKEN_STRING 6
+#define JSON_TOKEN_NUMBER 7
+#define JSON_TOKEN_BOOLEAN 8
+#define JSON_TOKEN_NULL 9
+
+//Key and string text is delivered in pieces of at most this many bytes
+#ifndef JSON_TOKEN_CHUNK_LEN
+#define JSON_TOKEN_CHUNK_LEN 32
+#endif
+//Deepest nesting nextToken() can follow
+#ifndef JSON_TOKEN_MAX_DEPTH
+#define JSON_TOKEN_MAX_DEPTH 32
+#endif
+
+//Results of PushParser::feed()
+#define JSON_PUSH_ERROR EOF
+#define JSON_PUSH_DONE 0 // a complete document is ready to take()
+#define JSON_PUSH_NEED_MORE 1
+
+//Deepest nesting PushParser can build
+#ifndef JSON_PUSH_MAX_DEPTH
+#define JSON_PUSH_MAX_DEPTH 16
+#endif
+//Deepest nesting parse(), parseInSitu() and LazyDocument::parse() will follow
+#ifndef JSON_PARSE_MAX_DEPTH
+#define JSON_PARSE_MAX_DEPTH 32
+#endif
+//Deepest nesting Document::parse() will follow
+#ifndef JSON_DOCUMENT_MAX_DEPTH
+#define JSON_DOCUMENT_MAX_DEPTH 32
+#endif
+//Deepest nesting parseCbor() will follow
+#ifndef JSON_CBOR_MAX_DEPTH
+#define JSON_CBOR_MAX_DEPTH 32
+#endif
+//Longest string, number or key PushParser can hold, quotes included
+#ifndef JSON_PUSH_TOKEN_LEN
+#define JSON_PUSH_TOKEN_LEN STRING_BUFFER_LEN
+#endif
 
 namespace Json {
 
-	Value parse(const char*);
+	/* Knobs shared by every parse entry point. */
+	struct ParseOptions {
+		/* Allocate the parsed document from this arena rather than the
+		 * heap; release it with arena->reset() instead of free_parsed(). */
+		Arena *arena = NULL;
+		/* Resolve object keys against this table, so members share its
+		 * strings and obj[key] with a Key from it compares addresses. */
+		KeyTable *keys = NULL;
+		/* Only build the values on these paths (see filter.h). The stream
+		 * parser takes its filter as an argument to parseValue() instead. */
+		const char *const *filter = NULL;
+	};
+
+	/* In-memory documents are parsed straight from the buffer; use the
+	 * aJsonStream classes for input that arrives over a Stream or Client. */
+	Value parse(const char*, const ParseOptions &options = ParseOptions());
+	Value parse(const char*, size_t len, const ParseOptions &options = ParseOptions());
+	/* Destructive parse: strings are unescaped in place and the document's
+	 * string values and keys point into buf, so buf must outlive it. */
+	Value parseInSitu(char *buf, size_t len, const ParseOptions &options = ParseOptions());
+	/* Parse one value that fills exactly len bytes of buf, for callers that
+	 * find value boundaries themselves. Returns EOF if it is malformed or
+	 * followed by anything but whitespace. */
+	int parseToken(Value *item, char *buf, size_t len, bool insitu, const ParseOptions &options);
+	/* Write value to out as a terminated string, truncated to size - 1
+	 * characters. Returns the number written. */
 	int dump(Json::Value value, char* out, size_t size);
+	/* Serialize value in one pass into a malloc'd, terminated string for
+	 * the caller to free(), or NULL if memory ran out. */
+	char *dumpToString(Json::Value value, size_t *length = NULL);
 	int print(Value, Print&);
 	int println(Value v, Print& p);
 	int measure(Value);
 
+	/* CBOR (RFC 8949) encoding of the same values, for links where text
+	 * costs too much. Doubles that a float holds exactly are sent as
+	 * floats. Returns the number of bytes written. */
+	int printCbor(Value, Print&);
+	/* Decode one CBOR item from buf, returning an invalid value if it is
+	 * malformed, nests deeper than JSON_CBOR_MAX_DEPTH or uses something
+	 * JSON cannot hold, such as byte strings or non-string map keys. Tags
+	 * are skipped. Use aJsonStream::parseCbor() for streams. */
+	Value parseCbor(const uint8_t *buf, size_t len, const ParseOptions &options = ParseOptions());
+
+	/* Print sink that grows to hold whatever is written to it, doubling
+	 * its capacity from the heap or an arena. clear() keeps the capacity,
+	 * so a buffer reused for messages of similar size settles at their
+	 * high-water mark and then serializes without allocating. */
+	class DynamicBuffer : public Print {
+	public:
+		DynamicBuffer(size_t capacity = 0, Arena *arena = NULL);
+		~DynamicBuffer();
+
+		virtual size_t write(uint8_t ch);
+		virtual size_t write(const uint8_t *buffer, size_t size);
+
+		/* The text so far, always terminated. */
+		const char *c_str() { return data ? data : ""; }
+		size_t length() { return _length; }
+		size_t capacity() { return _capacity; }
+		/* A write was dropped because memory ran out. */
+		bool failed() { return _failed; }
+		/* Make room for capacity characters up front. */
+		bool reserve(size_t capacity);
+		void clear();
+		/* Hand the heap buffer to the caller, who must free() it. */
+		char *release();
+
+	private:
+		char *data;
+		size_t _length;
+		size_t _capacity;
+		bool _failed;
+		Arena *arena;
+	};
+
+	/* One event from aJsonStream::nextToken(). */
+	struct Token {
+		int type;
+		/* JSON_TOKEN_NUMBER and JSON_TOKEN_BOOLEAN values. */
+		Value value;
+		/* JSON_TOKEN_KEY and JSON_TOKEN_STRING text, unescaped and NUL
+		 * terminated. A longer string arrives as several tokens of the
+		 * same type; all but the last have more set. */
+		char chunk[JSON_TOKEN_CHUNK_LEN + 1];
+		size_t length;
+		bool more;
+	};
+
 	/* aJsonStream is stream representation of aJson for its internal use;
 	 * it is meant to abstract out differences between Stream (e.g. serial
 	 * stream) and Client (which may or may not be connected) or provide even
@@ -51,24 +194,51 @@ namespace Json {
 	class aJsonStream : public Print {
 	public:
 		aJsonStream(Stream *stream_)
-			: stream_obj(stream_), bucket(EOF)
+			: stream_obj(stream_), bucket(EOF), token_state(0), token_depth(0)
 			{}
 		/* Use this to check if more data is available, as aJsonStream
 		 * can read some more data than really consumed and automatically
 		 * skips separating whitespace if you use this method. */
 		virtual bool available();
 
+		ParseOptions options;
+
 		int parseNumber(Value *);
 		int parseString(Value *);
+		/* Read and unescape a string into buffer without allocating,
+		 * returning its length or EOF. */
+		int readString(char *buffer, size_t size);
 
 		int skip();
 		void flush();
 
-		int parseValue(Value *, char** filter);
+		/* filter is NULL to parse everything, or a path list as described
+		 * in filter.h. A value that is filtered out comes back invalid. */
+		int parseValue(Value *, const char *const *filter);
+
+		int parseArray(Value *, const char *const *filter);
+
+		int parseObject(Value *, const char *const *filter);
 
-		int parseArray(Value *, char** filter);
+		/* Consume a value without building it. Only its nesting is checked. */
+		int skipValue();
 
-		int parseObject(Value *, char** filter);
+		/* Read one value, parsing only the parts path selects (see
+		 * path.h) into results and skipping the rest. Returns how many
+		 * matched, of which the first max are stored for the caller to
+		 * free_parsed(), or EOF if the input is malformed. */
+		int parsePath(const Path &path, Value *results, int max);
+
+		/* Read one CBOR item instead of JSON text. */
+		int parseCbor(Value *item);
+
+		/* Pull parser: read just enough input for the next event and
+		 * return its type, without building a tree. Memory use is bounded
+		 * by JSON_TOKEN_CHUNK_LEN and JSON_TOKEN_MAX_DEPTH whatever the
+		 * size of the document. Returns JSON_TOKEN_END once a complete
+		 * value has been read, after which the next call starts on the
+		 * following document. */
+		int nextToken(Token *token);
 
 	protected:
 		/* Blocking load of character, returning EOF if the stream
@@ -84,6 +254,7 @@ namespace Json {
 
 		/* Inherited from class Print. */
 		virtual size_t write(uint8_t ch);
+		virtual size_t write(const uint8_t *buffer, size_t size);
 
 		/* stream attribute is used only from virtual functions,
 		 * therefore an object inheriting aJsonStream may avoid
@@ -97,8 +268,133 @@ namespace Json {
 		 * to be returned by next getch() - returned by a call
 		 * to ungetch(). */
 		int bucket;
+
+	private:
+		int parsePathSegment(const Path &path, int at, Value *results, int max, int *found);
+		long readHex4();
+		int readEscape(int in, char *out);
+		int readChunk(Token *token);
+		int closeContainer(int in, Token *token);
+		int readCborHead(int *major, uint64_t *argument);
+		int parseCborItem(Value *item, int depth);
+		int parseCborString(Value *item, uint64_t length);
+		int parseCborArray(Value *item, bool indefinite, uint64_t count, int depth);
+		int parseCborMap(Value *item, bool indefinite, uint64_t count, int depth);
+
+		/* nextToken() position: what is expected next, and one bit
+		 * per open container, set for objects. */
+		uint8_t token_state;
+		uint8_t token_depth;
+		uint8_t token_stack[(JSON_TOKEN_MAX_DEPTH + 7) / 8];
+	};
+
+	/* Resumable parser for input that arrives in pieces, such as
+	 * non-blocking socket reads. Unlike aJsonStream it never waits for
+	 * data: feed() consumes what it is given, keeps its place in a fixed
+	 * size stack and returns JSON_PUSH_NEED_MORE until the document is
+	 * complete. */
+	class PushParser {
+	public:
+		PushParser(const ParseOptions &options = ParseOptions());
+		/* Frees a document that was not taken. */
+		~PushParser();
+
+		/* Parse the next len bytes of the document. Returns
+		 * JSON_PUSH_DONE once it is complete, leaving the rest of data
+		 * unread (see consumed()), or JSON_PUSH_ERROR on malformed input
+		 * or when a limit is exceeded. */
+		int feed(const uint8_t *data, size_t len);
+		/* Signal the end of input, which completes a top level number. */
+		int finish();
+		/* Bytes of data used by the last feed(). */
+		size_t consumed() { return used; }
+		/* Hand over the completed document and start on the next one. */
+		Value take();
+		/* Drop any partial document and start over. */
+		void reset();
+
+		ParseOptions options;
+
+	private:
+		bool step(uint8_t in);
+		bool open(uint8_t in);
+		bool close(uint8_t in);
+		bool completeToken();
+		bool attach(Value value);
+		bool fail();
+		int status();
+
+		Value root;
+		/* Open containers, and for objects the slot of the current key. */
+		Value stack[JSON_PUSH_MAX_DEPTH];
+		Value *slots[JSON_PUSH_MAX_DEPTH];
+		uint8_t depth;
+		uint8_t state;
+		bool escape;
+		size_t used;
+		size_t token_length;
+		char token[JSON_PUSH_TOKEN_LEN];
+	};
+
+	class LazyDocument;
+
+	/* Index entry for one container or object member value of a
+	 * LazyDocument. Nodes are stored in the order their values begin, so
+	 * the first child of a node is the next node and its next sibling is
+	 * subtree nodes further on. */
+	struct LazyNode {
+		const char *start; // the opening bracket, or first character
+		const char *end;   // just past the value
+		uint32_t subtree;  // nodes in this subtree, itself included
+		LazyDocument *doc;
+		Value value;       // the parsed container, invalid until first use
+	};
+
+	/* Parse on demand: parse() only checks the text and indexes where
+	 * each array, object and object member value begins and ends. A
+	 * container is parsed the first time asObject() or asArray() is
+	 * called on it, one level deep: an object gets its keys, while each
+	 * member value is skipped and parsed when first read. Results are
+	 * kept, so reading a few fields of a large message costs about as
+	 * much as those fields. Unread values are JSON_LAZY; print() writes
+	 * them out verbatim.
+	 *
+	 * The text must outlive the document, and everything read from it
+	 * belongs to the document: do not free_parsed() any of it. */
+	class LazyDocument {
+	public:
+		LazyDocument(const ParseOptions &options = ParseOptions())
+			: options(options), nodes(NULL), node_count(0), scalar(Value::invalid())
+			{}
+		~LazyDocument() { clear(); }
+
+		/* Index json. Returns 0, or EOF if it is malformed or memory ran
+		 * out, leaving the document empty. */
+		int parse(const char *json, size_t len);
+		int parse(const char *json) { return parse(json, strlen(json)); }
+
+		/* The top level value: lazy for a container, invalid if empty. */
+		Value root();
+		/* Free everything parsed so far and empty the document. */
+		void clear();
+
+		/* Arena and key table used as containers are parsed. */
+		ParseOptions options;
+
+	private:
+		LazyDocument(const LazyDocument &);
+		LazyDocument &operator=(const LazyDocument &);
+
+		LazyNode *nodes;
+		size_t node_count;
+		Value scalar;
 	};
 
+	/* Parse the value of node, one level deep for a container, leaving
+	 * nested containers and member values lazy. Defined with the buffer
+	 * parser. */
+	int parseLazy(LazyNode *node, Value *item);
+
 	/* JSON stream that consumes data from a connection (usually
 	 * Ethernet client) until the connection is closed. */
 	class aJsonClientStream : public aJsonStream {
@@ -115,8 +411,8 @@ namespace Json {
 	};
 
 	/* JSON stream that is bound to input and output string buffer. This is
-	 * for internal usage by string-based aJsonClass methods. */
-	/* TODO: Elastic output buffer support. */
+	 * for internal usage by string-based aJsonClass methods. Output of
+	 * unknown size is better printed to a DynamicBuffer. */
 	class aJsonStringStream : public aJsonStream {
 	public:
 		/* Either of inbuf, outbuf can be NULL if you do not care about
@@ -126,12 +422,17 @@ namespace Json {
 		{
 			inbuf_len = inbuf ? strlen(inbuf) : 0;
 		}
+		/* Binary input, such as CBOR, that may contain NUL bytes. */
+		aJsonStringStream(const uint8_t *inbuf_, size_t inbuf_len_)
+			: aJsonStream(NULL), inbuf((const char *)inbuf_), outbuf(NULL), inbuf_len(inbuf_len_), outbuf_len(0)
+			{}
 
 		virtual bool available();
 
 	private:
 		virtual int getch();
 		virtual size_t write(uint8_t ch);
+		virtual size_t write(const uint8_t *buffer, size_t size);
 
 		const char *inbuf;
 		char *outbuf;
@@ -0,0 +1,98 @@
+#include "keytable.h"
+
+using namespace Json;
+
+//Keys longer than this are never interned, matching AMap's limit
+#define MAX_INTERNED_LENGTH 0x3FFF
+
+KeyTable::KeyTable(int capacity, const char *const *seed_keys, int seed_count)
+    : count(0), seeds(0), _capacity(capacity) {
+    if(_capacity < seed_count)
+        _capacity = seed_count;
+    if(_capacity > 0x7FFF)
+        _capacity = 0x7FFF;
+    size_t buckets_len = 4;
+    while(buckets_len < (size_t)_capacity * 2)
+        buckets_len *= 2;
+    entries = (Key *)heapAlloc(sizeof(Key) * (_capacity ? _capacity : 1));
+    buckets = (uint16_t *)heapAlloc(sizeof(uint16_t) * buckets_len);
+    mask = buckets_len - 1;
+    if(!entries || !buckets) {
+        heapFree(entries, sizeof(Key) * (_capacity ? _capacity : 1));
+        heapFree(buckets, sizeof(uint16_t) * buckets_len);
+        entries = NULL;
+        buckets = NULL;
+        _capacity = 0;
+        return;
+    }
+    memset(buckets, 0, sizeof(uint16_t) * buckets_len);
+    for(int i = 0; i < seed_count && count < _capacity; i++) {
+        size_t length = strlen(seed_keys[i]);
+        uint32_t hash = hashKey(seed_keys[i], length);
+        if(length <= MAX_INTERNED_LENGTH && lookup(seed_keys[i], length, hash) < 0)
+            add(seed_keys[i], length, hash, false);
+    }
+    seeds = count;
+}
+
+KeyTable::~KeyTable() {
+    //Seeds belong to the caller
+    for(int i = seeds; i < count; i++)
+        heapFree((char *)entries[i].str, entries[i].length + 1);
+    heapFree(entries, sizeof(Key) * (_capacity ? _capacity : 1));
+    heapFree(buckets, sizeof(uint16_t) * (mask + 1));
+}
+
+int KeyTable::lookup(const char *key, size_t length, uint32_t hash) {
+    if(!_capacity)
+        return -1;
+    for(uint16_t i = hash & mask; buckets[i]; i = (i + 1) & mask) {
+        Key &entry = entries[buckets[i] - 1];
+        if(entry.hash == hash && entry.length == length && memcmp(entry.str, key, length) == 0)
+            return buckets[i] - 1;
+    }
+    return -1;
+}
+
+Key KeyTable::add(const char *key, size_t length, uint32_t hash, bool copy) {
+    Key entry = { NULL, 0, 0 };
+    const char *str = key;
+    if(copy) {
+        char *buf = (char *)heapAlloc(length + 1);
+        if(!buf)
+            return entry;
+        memcpy(buf, key, length);
+        buf[length] = 0;
+        str = buf;
+    }
+    entry.str = str;
+    entry.length = length;
+    entry.hash = hash;
+    entries[count] = entry;
+    uint16_t i = hash & mask;
+    while(buckets[i])
+        i = (i + 1) & mask;
+    buckets[i] = ++count;
+    return entry;
+}
+
+Key KeyTable::find(const char *key, size_t length) {
+    int i = lookup(key, length, hashKey(key, length));
+    if(i < 0) {
+        Key none = { NULL, 0, 0 };
+        return none;
+    }
+    return entries[i];
+}
+
+Key KeyTable::intern(const char *key, size_t length) {
+    uint32_t hash = hashKey(key, length);
+    int i = lookup(key, length, hash);
+    if(i >= 0)
+        return entries[i];
+    if(count >= _capacity || length > MAX_INTERNED_LENGTH) {
+        Key none = { NULL, 0, 0 };
+        return none;
+    }
+    return add(key, length, hash, true);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+
+namespace Json {
+
+    //FNV-1a, shared by the key table and the AMap index
+    inline uint32_t hashKey(const char *key, size_t length) {
+        uint32_t hash = 2166136261u;
+        while(length--)
+            hash = (hash ^ (uint8_t)*key++) * 16777619u;
+        return hash;
+    }
+
+    /* Handle to a key interned in a KeyTable. Every lookup of the same text
+     * in one table yields the same str pointer, so objects can compare
+     * interned keys by address. str is NULL if the key is not interned. */
+    struct Key {
+        const char *str;
+        uint16_t length;
+        uint32_t hash;
+        bool valid() const { return str != NULL; }
+    };
+
+    /* Fixed-capacity table of interned key strings. Seed it with the keys
+     * your messages are known to use; the parser (see ParseOptions::keys)
+     * resolves object keys against it and adds new ones while there is
+     * room. Objects then store the table's pointer instead of a copy, and
+     * obj[key] with a Key from the same table is a pointer comparison. The
+     * table must outlive every object that references its keys. */
+    class KeyTable {
+    public:
+        /* seeds are referenced, not copied, and must stay valid. */
+        KeyTable(int capacity, const char *const *seeds = NULL, int count = 0);
+        ~KeyTable();
+
+        /* Look up key without adding it. */
+        Key find(const char *key, size_t length);
+        Key find(const char *key) { return find(key, strlen(key)); }
+        /* Look up key, adding a copy of it if it is new and the table is
+         * not full yet. */
+        Key intern(const char *key, size_t length);
+        Key intern(const char *key) { return intern(key, strlen(key)); }
+
+        int size() { return count; }
+        int capacity() { return _capacity; }
+
+    private:
+        int lookup(const char *key, size_t length, uint32_t hash);
+        Key add(const char *key, size_t length, uint32_t hash, bool copy);
+
+        Key *entries;
+        //Open addressing table of entry numbers plus one, zero is empty
+        uint16_t *buckets;
+        uint16_t mask;
+        int count;
+        int seeds;
+        int _capacity;
+
+        KeyTable(const KeyTable&);
+    };
+}
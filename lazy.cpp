@@ -0,0 +1,234 @@
+#include <ctype.h>
+#include "json.h"
+#include "scan.h"
+#include "number.h"
+
+using namespace Json;
+
+// Checks a document and records where each container and object member
+// value begins and ends, building nothing else.
+class Indexer {
+public:
+    Indexer(const char *json, size_t len)
+        : p(json), end(json + len), nodes(NULL), used(0), size(0) {}
+
+    // depth counts the containers open around the value
+    int parseValue(int depth);
+    bool atEnd() {
+        p = skipWhitespace(p, end);
+        return p == end;
+    }
+
+    const char *p;
+    const char *end;
+    LazyNode *nodes;
+    size_t used, size;
+
+private:
+    int addNode(size_t *at);
+    int parseContainer(char close, int depth);
+    int parseString();
+    int parseKeyword(const char *keyword, size_t len);
+};
+
+int Indexer::parseValue(int depth) {
+    p = skipWhitespace(p, end);
+    if(p == end)
+        return EOF;
+    switch(*p) {
+    case '\"':
+        return parseString();
+    case '[':
+    case '{':
+        if(depth >= JSON_PARSE_MAX_DEPTH)
+            return EOF;
+        return parseContainer(*p == '[' ? ']' : '}', depth + 1);
+    case 'n':
+        return parseKeyword("null", 4);
+    case 't':
+        return parseKeyword("true", 4);
+    case 'f':
+        return parseKeyword("false", 5);
+    default: {
+        Value number;
+        const char *next = readNumber(p, end, &number);
+        if(!next)
+            return EOF;
+        p = next;
+        return 0;
+    }
+    }
+}
+
+int Indexer::parseKeyword(const char *keyword, size_t len) {
+    if((size_t)(end - p) < len || memcmp(p, keyword, len))
+        return EOF;
+    p += len;
+    return 0;
+}
+
+int Indexer::parseString() {
+    p++;
+    while((p = scanString(p, end)) < end && *p != '\"') {
+        if(*p != '\\' || ++p == end)
+            return EOF;
+        if(*p++ == 'u') {
+            for(int i = 0; i < 4; i++, p++)
+                if(p == end || !isxdigit((unsigned char)*p))
+                    return EOF;
+        }
+    }
+    if(p >= end)
+        return EOF;
+    p++;
+    return 0;
+}
+
+// Append a node, setting at to its index: nodes may move as more are added.
+int Indexer::addNode(size_t *at) {
+    if(used == size) {
+        size_t grown_size = size ? size * 2 : 8;
+        LazyNode *grown = (LazyNode *)heapRealloc(nodes, size * sizeof(LazyNode), grown_size * sizeof(LazyNode));
+        if(!grown)
+            return EOF;
+        nodes = grown;
+        size = grown_size;
+    }
+    *at = used++;
+    return 0;
+}
+
+int Indexer::parseContainer(char close, int depth) {
+    size_t at;
+    if(addNode(&at))
+        return EOF;
+    nodes[at].start = p++;
+    p = skipWhitespace(p, end);
+    if(p < end && *p == close)
+        p++;
+    else {
+        for(;;) {
+            if(close == '}') {
+                p = skipWhitespace(p, end);
+                if(p == end || *p != '\"' || parseString())
+                    return EOF;
+                p = skipWhitespace(p, end);
+                if(p == end || *p++ != ':')
+                    return EOF;
+            }
+            // A plain member value gets a node of its own too, so looking
+            // it up parses it alone
+            p = skipWhitespace(p, end);
+            bool member = close == '}' && p < end && *p != '[' && *p != '{';
+            size_t value = 0;
+            if(member && addNode(&value))
+                return EOF;
+            const char *start = p;
+            if(parseValue(depth))
+                return EOF;
+            if(member) {
+                nodes[value].start = start;
+                nodes[value].end = p;
+                nodes[value].subtree = 1;
+            }
+            p = skipWhitespace(p, end);
+            if(p == end)
+                return EOF;
+            if(*p++ == close)
+                break;
+            if(p[-1] != ',')
+                return EOF;
+        }
+    }
+    nodes[at].end = p;
+    nodes[at].subtree = used - at;
+    return 0;
+}
+
+int LazyDocument::parse(const char *json, size_t len) {
+#ifdef JSON_STATS
+    StatsTimer timer(stats.parse_micros);
+    stats.bytes_parsed += len;
+#endif
+    clear();
+    Indexer indexer(json, len);
+    if(indexer.parseValue(0) || !indexer.atEnd()) {
+        heapFree(indexer.nodes, indexer.size * sizeof(LazyNode));
+        return EOF;
+    }
+    if(indexer.used == 0) {
+        // Nothing to defer for a lone scalar
+        return parseToken(&scalar, (char *)json, len, false, options);
+    }
+    // Trim the spare room, so clear() knows the size to free
+    nodes = (LazyNode *)heapRealloc(indexer.nodes, indexer.size * sizeof(LazyNode), indexer.used * sizeof(LazyNode));
+    if(!nodes) {
+        heapFree(indexer.nodes, indexer.size * sizeof(LazyNode));
+        return EOF;
+    }
+    node_count = indexer.used;
+    for(size_t i = 0; i < node_count; i++) {
+        nodes[i].doc = this;
+        nodes[i].value = Value::invalid();
+    }
+    return 0;
+}
+
+Value LazyDocument::root() {
+    if(nodes)
+        return Value(&nodes[0]);
+    Value output = scalar;
+    output.flags |= JSON_FLAG_BORROWED;
+    return output;
+}
+
+void LazyDocument::clear() {
+    // Each container is freed here only: the copies handed out, including
+    // those inside parent containers, are marked borrowed
+    for(size_t i = 0; i < node_count; i++) {
+        Value value = nodes[i].value;
+        value.flags &= ~JSON_FLAG_BORROWED;
+        if(!options.arena)
+            value.free_parsed();
+    }
+    heapFree(nodes, node_count * sizeof(LazyNode));
+    nodes = NULL;
+    node_count = 0;
+    scalar.free_parsed();
+    scalar = Value::invalid();
+}
+
+// Object or array without parsing it; JSON_INVALID for a member value
+// that is neither.
+int Value::lazyType() {
+    switch(*valuelazy->start) {
+    case '{':
+        return JSON_OBJECT;
+    case '[':
+        return JSON_ARRAY;
+    default:
+        return JSON_INVALID;
+    }
+}
+
+const char *Value::lazyText(size_t *length) {
+    if(type != JSON_LAZY || !valuelazy->value.isInvalid())
+        return NULL;
+    *length = valuelazy->end - valuelazy->start;
+    return valuelazy->start;
+}
+
+void Value::materializeLazy() {
+    LazyNode *node = valuelazy;
+    if(node->value.isInvalid()) {
+        Value parsed = Value::invalid();
+        // Only running out of memory fails here; a container cut short
+        // still holds what was parsed
+        int status = parseLazy(node, &parsed);
+        if(status == 0 || parsed.type == JSON_ARRAY || parsed.type == JSON_OBJECT) {
+            parsed.flags |= JSON_FLAG_BORROWED;
+            node->value = parsed;
+        }
+    }
+    *this = node->value;
+}
@@ -0,0 +1,136 @@
+#include <float.h>
+#include <stdlib.h>
+#include "json.h"
+#include "number.h"
+
+using namespace Json;
+
+//Significant digits that always fit the 64 bit mantissa
+#define MANTISSA_DIGITS 19
+
+//Largest power of ten a double holds exactly, so that one multiplication
+//or division of an exact mantissa is correctly rounded (Clinger)
+#if DBL_MANT_DIG >= 53
+#define EXACT_POW10 22
+#else
+#define EXACT_POW10 10
+#endif
+
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Exact conversion for what the fast path cannot do, via the C library on
+// a terminated copy of the number.
+static double slowConvert(const char *start, const char *end)
+{
+    char buffer[JSON_NUMBER_LEN];
+    size_t len = end - start;
+    char *copy = len < sizeof(buffer) ? buffer : (char *) heapAlloc(len + 1);
+    if (!copy)
+        return 0.0;
+    memcpy(copy, start, len);
+    copy[len] = 0;
+    double d = strtod(copy, NULL);
+    if (copy != buffer)
+        heapFree(copy, len + 1);
+    return d;
+}
+
+const char *Json::readNumber(const char *p, const char *end, Value *item)
+{
+    const char *start = p;
+    bool negative = p < end && *p == '-';
+    if (negative)
+        p++;
+    if (p == end || !isDigit(*p))
+        return NULL;
+
+    // The first MANTISSA_DIGITS significant digits, scaled by 10^exponent
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool truncated = false;
+    while (p < end && isDigit(*p))
+    {
+        if (digits < MANTISSA_DIGITS)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        }
+        else
+        {
+            truncated |= *p != '0';
+            exponent++;
+        }
+        p++;
+    }
+    bool integer = true;
+    if (p < end && *p == '.')
+    {
+        integer = false;
+        if (++p == end || !isDigit(*p))
+            return NULL;
+        while (p < end && isDigit(*p))
+        {
+            if (digits < MANTISSA_DIGITS)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+            else
+            {
+                truncated |= *p != '0';
+            }
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        integer = false;
+        bool negative_exponent = false;
+        if (++p < end && (*p == '+' || *p == '-'))
+            negative_exponent = *p++ == '-';
+        if (p == end || !isDigit(*p))
+            return NULL;
+        int e = 0;
+        while (p < end && isDigit(*p))
+        {
+            // Far past the range of a double either way
+            if (e < 100000)
+                e = e * 10 + (*p - '0');
+            p++;
+        }
+        exponent += negative_exponent ? -e : e;
+    }
+
+    // Integers are exact if they fit, the fraction and exponent of a
+    // double need rounding
+    const uint64_t int_max = ((uint64_t) 1 << (sizeof(json_int_t) * 8 - 1)) - 1;
+    if (integer && exponent == 0 && mantissa <= int_max + negative)
+    {
+        *item = Value((json_int_t) (negative ? 0 - mantissa : mantissa));
+        return p;
+    }
+    double d = 0.0;
+    if (mantissa != 0)
+    {
+        if (truncated || mantissa > ((uint64_t) 1 << DBL_MANT_DIG)
+            || exponent < -EXACT_POW10 || exponent > EXACT_POW10)
+        {
+            *item = Value(slowConvert(start, p));
+            return p;
+        }
+        d = exponent < 0 ? (double) mantissa / powers_of_ten[-exponent]
+                         : (double) mantissa * powers_of_ten[exponent];
+    }
+    *item = Value(negative ? -d : d);
+    return p;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "types.h"
+
+//Longest number the stream parser will read
+#ifndef JSON_NUMBER_LEN
+#define JSON_NUMBER_LEN 64
+#endif
+//Room writeDouble() needs
+#define JSON_DOUBLE_LEN 32
+
+namespace Json {
+
+    /* Parse the JSON number at the start of [p, end) into item, shared by
+     * every parser. Integers that fit json_int_t stay integers, anything
+     * else becomes the correctly rounded double. Returns the end of the
+     * number, or NULL if p does not start a valid one. */
+    const char *readNumber(const char *p, const char *end, Value *item);
+
+    /* Write the shortest text that reads back as d, always with a '.' or
+     * an exponent so it parses as a double again; NaN and infinities are
+     * written as null. Returns the end of the text, which is not
+     * terminated. */
+    char *writeDouble(char *out, double d);
+}
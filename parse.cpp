@@ -1,17 +1,8 @@
 #include "json.h"
+#include "scan.h"
 
 using namespace Json;
 
-// Parse an object - create a new root, and populate.
-Value Json::parse(const char *value)
-{
-    Value output;
-    aJsonStringStream stream(value, NULL);
-    stream.skip();
-    stream.parseValue(&output, NULL);
-    return output;
-}
-
 // Utility to jump whitespace and cr/lf
 int aJsonStream::skip()
 {
@@ -42,8 +33,11 @@ void aJsonStream::flush()
 
 
 // Parser core - when encountering text, process appropriately.
-int aJsonStream::parseValue(Value *item, char** filter)
+int aJsonStream::parseValue(Value *item, const char *const *filter)
 {
+#ifdef JSON_STATS
+    stats.nodes++;
+#endif
     if (this->skip() == EOF)
         {
             return EOF;
@@ -55,6 +49,12 @@ int aJsonStream::parseValue(Value *item, char** filter)
             return EOF;
         }
     this->ungetch(in);
+    //a filter path going into a plain value cannot match
+    if (filter && in != '[' && in != '{')
+        {
+            *item = Value::invalid();
+            return this->skipValue();
+        }
     if (in == '\"')
         {
             return this->parseString(item);
@@ -128,82 +128,196 @@ int aJsonStream::parseValue(Value *item, char** filter)
 // Parse the input text into an unescaped cstring, and populate item.
 int
 aJsonStream::parseString(Value *item)
+{
+    char buffer[STRING_BUFFER_LEN];
+    int length = this->readString(buffer, sizeof(buffer));
+    if (length == EOF)
+        return EOF;
+    *item = Value(buffer, length, options.arena);
+    return item->isInvalid() ? EOF : 0;
+}
+
+// Read a string into buffer and unescape it. Returns its length, or EOF if
+// it is malformed or longer than size - 1 characters.
+int
+aJsonStream::readString(char *buffer, size_t size)
 {
     //we do not need to skip here since the first byte should be '\"'
     int in = this->getch();
     if (in != '\"')
         return EOF; // not a string!
-    char buffer[256];
-    memset(buffer, 0, sizeof(buffer));
     in = this->getch();
-    int i = 0;
-    while (in != EOF)
+    size_t i = 0;
+    while (in != '\"' && in >= 32)
     {
-        while (in != '\"' && in >= 32)
+        if (in != '\\')
         {
-            if (in != '\\')
-            {
-                buffer[i] = in;
-            }
+            if (i + 1 >= size)
+                return EOF;
+            buffer[i++] = in;
+        }
+        else
+        {
+            char decoded[JSON_ESCAPE_MAX_BYTES];
+            int length = this->readEscape(this->getch(), decoded);
+            if (length == EOF || i + length >= size)
+                return EOF;
+            memcpy(buffer + i, decoded, length);
+            i += length;
+        }
+        in = this->getch();
+        if (in == EOF)
+            return EOF;
+    }
+    if (in != '\"')
+        return EOF;
+    //the string ends here
+    buffer[i] = 0;
+    return i;
+}
+
+// Read the four hex digits of a \u escape, returns -1 if malformed.
+long aJsonStream::readHex4()
+{
+    long code = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        int digit = hexValue(this->getch());
+        if (digit < 0)
+            return -1;
+        code = (code << 4) | digit;
+    }
+    return code;
+}
+
+// Decode the escape whose backslash has just been read, in being the
+// character after it, into out. Returns the number of bytes written, at
+// most JSON_ESCAPE_MAX_BYTES, or EOF if the escape is malformed.
+int aJsonStream::readEscape(int in, char *out)
+{
+    switch (in)
+    {
+    case '\\':
+    case '\"':
+    case '/':
+        *out = in;
+        return 1;
+    case 'b':
+        *out = '\b';
+        return 1;
+    case 'f':
+        *out = '\f';
+        return 1;
+    case 'n':
+        *out = '\n';
+        return 1;
+    case 'r':
+        *out = '\r';
+        return 1;
+    case 't':
+        *out = '\t';
+        return 1;
+    case 'u':
+        break;
+    default:
+        return EOF;
+    }
+    long code = this->readHex4();
+    if (code < 0)
+        return EOF;
+    char *end = out;
+    // A high surrogate needs its low half to form the code point
+    if (code >= 0xD800 && code <= 0xDBFF)
+    {
+        in = this->getch();
+        if (in != '\\')
+        {
+            if (in != EOF)
+                this->ungetch(in);
+        }
+        else if ((in = this->getch()) != 'u')
+        {
+            // Any other escape stands on its own
+            end = writeUtf8(end, code);
+            int length = this->readEscape(in, end);
+            return length == EOF ? EOF : end - out + length;
+        }
+        else
+        {
+            long low = this->readHex4();
+            if (low < 0)
+                return EOF;
+            if (low >= 0xDC00 && low <= 0xDFFF)
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
             else
             {
-                in = this->getch();
-                if (in == EOF)
-                    return EOF;
-
-                switch (in)
-                {
-                case '\\':
-                    buffer[i] = '\\';
-                    break;
-                case '\"':
-                    buffer[i] = '\"';
-                    break;
-                case '/':
-                    buffer[i] = '/';
-                    break;
-                case 'b':
-                    buffer[i] = '\b';
-                    break;
-                case 'f':
-                    buffer[i] = '\f';
-                    break;
-                case 'n':
-                    buffer[i] = '\n';
-                    break;
-                case 'r':
-                    buffer[i] = '\r';
-                    break;
-                case 't':
-                    buffer[i] = '\t';
-                    break;
-                default:
-                    //we do not understand it so we skip it
-                    break;
-                }
+                end = writeUtf8(end, code);
+                code = low;
             }
-            i++;
-            in = this->getch();
-            if (in == EOF)
-                return EOF;
         }
-        //the string ends here
-        *item = buffer;
-        return 0;
     }
-    //we should not be here but it is ok
-    return 0;
+    return writeUtf8(end, code) - out;
 }
 
+// Consume a value without building it, for values a filter leaves out.
+// Strings and nesting are followed, scalars are taken up to the next
+// delimiter without checking them.
+int aJsonStream::skipValue()
+{
+    int depth = 0;
+    do
+    {
+        if (this->skip() == EOF)
+            return EOF;
+        int in = this->getch();
+        if (in == '{' || in == '[')
+        {
+            depth++;
+        }
+        else if (in == '}' || in == ']')
+        {
+            depth--;
+        }
+        else if (in == ',' || in == ':')
+        {
+            if (depth == 0)
+                return EOF;
+        }
+        else if (in == '\"')
+        {
+            while ((in = this->getch()) != '\"')
+            {
+                if (in == EOF || (in == '\\' && this->getch() == EOF))
+                    return EOF;
+            }
+        }
+        else
+        {
+            while (in != EOF && in > 32 && in != ',' && in != ':' && in != ']' && in != '}')
+                in = this->getch();
+            if (in != EOF)
+                this->ungetch(in);
+        }
+    } while (depth > 0);
+    return depth < 0 ? EOF : 0;
+}
 
 // Build an array from input text.
-int aJsonStream::parseArray(Value * item, char** filter)
+int aJsonStream::parseArray(Value * item, const char *const *filter)
 {
+#ifdef JSON_STATS
+    StatsDepth nesting;
+#endif
     int in = this->getch();
     if (in != '[')
             return EOF; // not an array!
 
-    *item = *(new Array());
+    Array *array = create<Array>(options.arena);
+    if (!array)
+        return EOF;
+    *item = array;
+    if (options.arena)
+        item->flags |= JSON_FLAG_BORROWED;
     this->skip();
     in = this->getch();
     //check for empty array
@@ -214,15 +328,25 @@ int aJsonStream::parseArray(Value * item, char** filter)
     //now put back the last character
     this->ungetch(in);
 
+    int index = 0;
     do
     {
-        Value new_item;
+        const char *children[JSON_FILTER_MAX + 1];
+        int match = filter ? narrowFilter(filter, NULL, 0, index++, children) : FILTER_ALL;
+        Value new_item = Value::invalid();
         this->skip();
-        if (this->parseValue(&new_item, filter))
+        int status = match == FILTER_SKIP ? this->skipValue()
+                                          : this->parseValue(&new_item, match == FILTER_SOME ? children : NULL);
+        if (status)
         {
+            new_item.free_parsed();
+            return EOF;
+        }
+        if (!new_item.isInvalid() && !item->asArray().append(new_item))
+        {
+            new_item.free_parsed();
             return EOF;
         }
-        item->asArray().append(new_item);
         this->skip();
         in = this->getch();
     } while(in == ',');
@@ -238,15 +362,23 @@ int aJsonStream::parseArray(Value * item, char** filter)
 
 
 // Build an object from the text.
-int aJsonStream::parseObject(Value *item, char** filter)
+int aJsonStream::parseObject(Value *item, const char *const *filter)
 {
+#ifdef JSON_STATS
+    StatsDepth nesting;
+#endif
     int in = this->getch();
     if (in != '{')
     {
         return EOF; // not an object!
     }
 
-    *item = *(new Object());
+    Object *object = create<Object>(options.arena);
+    if (!object)
+        return EOF;
+    *item = object;
+    if (options.arena)
+        item->flags |= JSON_FLAG_BORROWED;
     this->skip();
     //check for an empty object
     in = this->getch();
@@ -259,9 +391,10 @@ int aJsonStream::parseObject(Value *item, char** filter)
 
     do
     {
-        Value key_name;
+        char key_name[STRING_BUFFER_LEN];
         this->skip();
-        if (this->parseString(&key_name) == EOF)
+        int key_length = this->readString(key_name, sizeof(key_name));
+        if (key_length == EOF)
         {
             return EOF;
         }
@@ -274,13 +407,35 @@ int aJsonStream::parseObject(Value *item, char** filter)
         }
         // skip any spacing, get the value.
         this->skip();
-        Value value;
-        if (this->parseValue(&value, filter) == EOF)
+        const char *children[JSON_FILTER_MAX + 1];
+        int match = filter ? narrowFilter(filter, key_name, key_length, -1, children) : FILTER_ALL;
+        Value value = Value::invalid();
+        int status = match == FILTER_SKIP ? this->skipValue()
+                                          : this->parseValue(&value, match == FILTER_SOME ? children : NULL);
+        if (status)
+        {
+            value.free_parsed();
+            return EOF;
+        }
+        if (value.isInvalid())
+        {
+            // filtered out
+            this->skip();
+            in = this->getch();
+            continue;
+        }
+        // Interned keys are shared, others are copied into the key pool
+        Key interned = options.keys ? options.keys->intern(key_name, key_length) : Key();
+        Value *slot = interned.valid() ? item->asObject().get_create(interned)
+                                       : item->asObject().get_create(key_name);
+        if (!slot)
         {
+            value.free_parsed();
             return EOF;
         }
-        (item->asObject())[key_name.asString()] = value;
-        key_name.free_parsed();
+        // A repeated key replaces the earlier value
+        slot->free_parsed();
+        *slot = value;
         this->skip();
         in = this->getch();
     } while (in == ',');
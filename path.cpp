@@ -0,0 +1,173 @@
+#include "json.h"
+
+using namespace Json;
+
+void Path::clear() {
+    heapFree(text, text_size);
+    text = NULL;
+    text_size = 0;
+    count = -1;
+}
+
+int Path::compile(const char *pointer) {
+    clear();
+    size_t length = strlen(pointer);
+    if(length && *pointer != '/')
+        return EOF;
+    // Unescaping only shortens segments, and each '/' becomes a terminator
+    text = (char *)heapAlloc(length + 1);
+    if(!text)
+        return EOF;
+    text_size = length + 1;
+    const char *in = pointer;
+    char *out = text;
+    int segment_count = 0;
+    while(*in) {
+        if(segment_count == JSON_PATH_MAX_SEGMENTS) {
+            clear();
+            return EOF;
+        }
+        Segment &segment = segments[segment_count++];
+        segment.key = out;
+        for(in++; *in && *in != '/'; in++) {
+            if(*in != '~')
+                *out++ = *in;
+            else if(in[1] == '0' || in[1] == '1')
+                *out++ = *++in == '0' ? '~' : '/';
+            else {
+                clear();
+                return EOF;
+            }
+        }
+        segment.length = out - segment.key;
+        *out++ = 0;
+        segment.hash = hashKey(segment.key, segment.length);
+        // Array indices are digits without a leading zero
+        segment.index = -1;
+        if(segment.length && segment.length < 10 && (segment.key[0] != '0' || segment.length == 1)) {
+            segment.index = 0;
+            for(size_t i = 0; i < segment.length && segment.index >= 0; i++) {
+                char c = segment.key[i];
+                segment.index = c >= '0' && c <= '9' ? segment.index * 10 + (c - '0') : -1;
+            }
+        }
+        if(segment.length == 3 && !memcmp(segment.key, "[*]", 3))
+            segment.key = NULL;
+    }
+    count = segment_count;
+    return 0;
+}
+
+int Path::match(Value value, int at, Value *results, int max, int found) const {
+    if(at == count) {
+        // Nothing stored here, such as a slot left by a failed insert
+        if(value.isInvalid())
+            return found;
+        if(found < max)
+            results[found] = value;
+        return found + 1;
+    }
+    const Segment &segment = segments[at];
+    if(value.isObject()) {
+        Object &object = value.asObject();
+        if(segment.key) {
+            Value *member = object.get(segment.key, segment.length, segment.hash);
+            return member ? match(*member, at + 1, results, max, found) : found;
+        }
+        for(auto &kvp : object) {
+            if(kvp.valid)
+                found = match(kvp.value, at + 1, results, max, found);
+        }
+    }
+    else if(value.isArray()) {
+        Array &array = value.asArray();
+        if(segment.key) {
+            if(segment.index >= 0 && segment.index < array.size())
+                found = match(array[segment.index], at + 1, results, max, found);
+            return found;
+        }
+        for(auto &element : array)
+            found = match(element, at + 1, results, max, found);
+    }
+    return found;
+}
+
+int Path::find(Value root, Value *results, int max) const {
+    if(!valid())
+        return EOF;
+    return match(root, 0, results, max, 0);
+}
+
+Value Path::get(Value root) const {
+    Value output = Value::invalid();
+    return find(root, &output, 1) > 0 ? output : Value::invalid();
+}
+
+int aJsonStream::parsePath(const Path &path, Value *results, int max) {
+    if(!path.valid())
+        return EOF;
+    int found = 0;
+    if(this->parsePathSegment(path, 0, results, max, &found)) {
+        for(int i = 0; i < found && i < max; i++) {
+            results[i].free_parsed();
+            results[i] = Value::invalid();
+        }
+        return EOF;
+    }
+    return found;
+}
+
+int aJsonStream::parsePathSegment(const Path &path, int at, Value *results, int max, int *found) {
+    if(this->skip() == EOF)
+        return EOF;
+    if(at == path.count) {
+        if(*found >= max) {
+            (*found)++;
+            return this->skipValue();
+        }
+        Value value = Value::invalid();
+        if(this->parseValue(&value, NULL)) {
+            value.free_parsed();
+            return EOF;
+        }
+        results[(*found)++] = value;
+        return 0;
+    }
+    int open = this->getch();
+    if(open != '{' && open != '[') {
+        // A path going into a plain value cannot match
+        this->ungetch(open);
+        return this->skipValue();
+    }
+    int close = open == '{' ? '}' : ']';
+    const Path::Segment &segment = path.segments[at];
+    this->skip();
+    int in = this->getch();
+    if(in == close)
+        return 0;
+    this->ungetch(in);
+    int index = 0;
+    do {
+        bool matched;
+        this->skip();
+        if(open == '{') {
+            char key[STRING_BUFFER_LEN];
+            int length = this->readString(key, sizeof(key));
+            if(length == EOF)
+                return EOF;
+            this->skip();
+            if(this->getch() != ':')
+                return EOF;
+            matched = !segment.key || ((size_t)length == segment.length && !memcmp(key, segment.key, length));
+        }
+        else
+            matched = !segment.key || segment.index == index++;
+        int status = matched ? this->parsePathSegment(path, at + 1, results, max, found)
+                             : this->skipValue();
+        if(status)
+            return EOF;
+        this->skip();
+        in = this->getch();
+    } while(in == ',');
+    return in == close ? 0 : EOF;
+}
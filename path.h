@@ -0,0 +1,62 @@
+#pragma once
+
+#include "types.h"
+
+/* Compiled JSON Pointers (RFC 6901), such as "/sensors/0/temp", for
+ * reading the same fields out of many documents. A segment of "[*]"
+ * matches every member or element at that level, so "/sensors/[*]/temp"
+ * reaches the temp of each sensor. "" is the whole document.
+ *
+ * A path is parsed once, with its keys unescaped and hashed, and reading
+ * with it never adds to the document the way obj[key] does for a missing
+ * key. A literal "[*]" key cannot be selected. */
+
+//Most segments a path can hold
+#ifndef JSON_PATH_MAX_SEGMENTS
+#define JSON_PATH_MAX_SEGMENTS 8
+#endif
+
+namespace Json {
+
+    class aJsonStream;
+
+    class Path {
+    public:
+        Path() : text(NULL), text_size(0), count(-1) {}
+        explicit Path(const char *pointer) : Path() { compile(pointer); }
+        ~Path() { clear(); }
+
+        /* Returns 0, or EOF if pointer is malformed, too long or memory ran
+         * out, leaving the path invalid. */
+        int compile(const char *pointer);
+        bool valid() const { return count >= 0; }
+
+        /* Evaluate against a tree. Returns how many values matched, of
+         * which the first max are stored in results, or EOF if the path is
+         * invalid. Results share storage with root: read them, and do not
+         * free_parsed() them. */
+        int find(Value root, Value *results, int max) const;
+        /* The first match, or an invalid value. */
+        Value get(Value root) const;
+
+    private:
+        Path(const Path &);
+        Path &operator=(const Path &);
+        friend class aJsonStream;
+
+        struct Segment {
+            const char *key; // unescaped, NULL for [*]
+            size_t length;
+            uint32_t hash;
+            int index;       // the key as an array index, or -1
+        };
+
+        void clear();
+        int match(Value value, int at, Value *results, int max, int found) const;
+
+        char *text;
+        size_t text_size;
+        int count;
+        Segment segments[JSON_PATH_MAX_SEGMENTS];
+    };
+}
@@ -0,0 +1,253 @@
+#include "json.h"
+
+using namespace Json;
+
+// What PushParser expects to read next.
+#define STATE_VALUE 0       // a value; where every document starts
+#define STATE_FIRST_VALUE 1 // a value or ']' straight after '['
+#define STATE_KEY 2         // a key after ','
+#define STATE_FIRST_KEY 3   // a key or '}' straight after '{'
+#define STATE_COLON 4       // the ':' after a key
+#define STATE_NEXT 5        // ',' or the end of the enclosing container
+#define STATE_STRING 6      // inside a string value
+#define STATE_KEY_STRING 7  // inside a key
+#define STATE_SCALAR 8      // inside a number, true, false or null
+#define STATE_DONE 9
+#define STATE_ERROR 10
+
+PushParser::PushParser(const ParseOptions &options)
+    : options(options), depth(0), state(STATE_VALUE), escape(false), used(0), token_length(0)
+{
+}
+
+PushParser::~PushParser()
+{
+    root.free_parsed();
+}
+
+void PushParser::reset()
+{
+    root.free_parsed();
+    root = Value();
+    depth = 0;
+    state = STATE_VALUE;
+    escape = false;
+    token_length = 0;
+}
+
+Value PushParser::take()
+{
+    Value output = state == STATE_DONE ? root : Value::invalid();
+    if (state == STATE_DONE)
+        root = Value();
+    this->reset();
+    return output;
+}
+
+int PushParser::status()
+{
+    if (state == STATE_DONE)
+        return JSON_PUSH_DONE;
+    return state == STATE_ERROR ? JSON_PUSH_ERROR : JSON_PUSH_NEED_MORE;
+}
+
+int PushParser::feed(const uint8_t *data, size_t len)
+{
+    used = 0;
+    while (used < len && state != STATE_DONE && state != STATE_ERROR)
+    {
+        if (this->step(data[used]))
+            used++;
+    }
+#ifdef JSON_STATS
+    stats.bytes_parsed += used;
+#endif
+    return this->status();
+}
+
+int PushParser::finish()
+{
+    if (state == STATE_SCALAR)
+        this->completeToken();
+    if (state != STATE_DONE)
+        this->fail();
+    return this->status();
+}
+
+// Drop the partial document. Returns true so step() consumes the byte.
+bool PushParser::fail()
+{
+    root.free_parsed();
+    root = Value();
+    depth = 0;
+    state = STATE_ERROR;
+    return true;
+}
+
+// Process one byte. Returns false if it ended a number or keyword and has
+// to be looked at again as the start of what follows.
+bool PushParser::step(uint8_t in)
+{
+    if (state == STATE_STRING || state == STATE_KEY_STRING)
+    {
+        if (in < 32 || token_length == JSON_PUSH_TOKEN_LEN)
+            return this->fail();
+        token[token_length++] = in;
+        if (in == '\"' && !escape)
+            this->completeToken();
+        else
+            escape = !escape && in == '\\';
+        return true;
+    }
+    if (state == STATE_SCALAR)
+    {
+        if (in <= 32 || in == ',' || in == ':' || in == ']' || in == '}' || in == '[' || in == '{' || in == '\"')
+        {
+            this->completeToken();
+            return false;
+        }
+        if (token_length == JSON_PUSH_TOKEN_LEN)
+            return this->fail();
+        token[token_length++] = in;
+        return true;
+    }
+    // skip whitespace between tokens
+    if (in <= 32)
+        return true;
+    switch (state)
+    {
+    case STATE_FIRST_KEY:
+        if (in == '}')
+            return this->close(in);
+        // fall through
+    case STATE_KEY:
+        if (in != '\"')
+            return this->fail();
+        token[0] = in;
+        token_length = 1;
+        escape = false;
+        state = STATE_KEY_STRING;
+        return true;
+    case STATE_COLON:
+        if (in != ':')
+            return this->fail();
+        state = STATE_VALUE;
+        return true;
+    case STATE_NEXT:
+        if (in == ',')
+        {
+            state = stack[depth - 1].isObject() ? STATE_KEY : STATE_VALUE;
+            return true;
+        }
+        return this->close(in);
+    case STATE_FIRST_VALUE:
+        if (in == ']')
+            return this->close(in);
+        // fall through
+    default:
+        break;
+    }
+
+    // The start of a value
+    if (in == '{' || in == '[')
+        return this->open(in);
+    token[0] = in;
+    token_length = 1;
+    escape = false;
+    state = in == '\"' ? STATE_STRING : STATE_SCALAR;
+    return true;
+}
+
+bool PushParser::open(uint8_t in)
+{
+    if (depth == JSON_PUSH_MAX_DEPTH)
+        return this->fail();
+    Value value;
+    if (in == '{')
+    {
+        Object *object = create<Object>(options.arena);
+        if (!object)
+            return this->fail();
+        value = object;
+    }
+    else
+    {
+        Array *array = create<Array>(options.arena);
+        if (!array)
+            return this->fail();
+        value = array;
+    }
+    if (options.arena)
+        value.flags |= JSON_FLAG_BORROWED;
+    // Hung into the document straight away, so fail() frees it with the rest
+    if (!this->attach(value))
+    {
+        value.free_parsed();
+        return this->fail();
+    }
+    stack[depth++] = value;
+#ifdef JSON_STATS
+    stats.nodes++;
+    if (depth > stats.max_depth)
+        stats.max_depth = depth;
+#endif
+    state = in == '{' ? STATE_FIRST_KEY : STATE_FIRST_VALUE;
+    return true;
+}
+
+bool PushParser::close(uint8_t in)
+{
+    if (depth == 0 || in != (stack[depth - 1].isObject() ? '}' : ']'))
+        return this->fail();
+    depth--;
+    state = depth ? STATE_NEXT : STATE_DONE;
+    return true;
+}
+
+// Add a finished value to the open container, or make it the document.
+bool PushParser::attach(Value value)
+{
+    if (depth == 0)
+        root = value;
+    else if (stack[depth - 1].isArray())
+        return stack[depth - 1].asArray().append(value);
+    else
+        *slots[depth - 1] = value;
+    return true;
+}
+
+// Turn the buffered key, string or scalar into a value.
+bool PushParser::completeToken()
+{
+    Value value;
+    if (state == STATE_KEY_STRING)
+    {
+        // Unescaped in place; the object takes its own copy
+        if (parseToken(&value, token, token_length, true, options))
+            return this->fail();
+#ifdef JSON_STATS
+        stats.nodes--; // parsed like a string value, but it is a key
+#endif
+        const char *key = value.asString();
+        Key interned = options.keys ? options.keys->intern(key, strlen(key)) : Key();
+        Object &object = stack[depth - 1].asObject();
+        Value *slot = interned.valid() ? object.get_create(interned) : object.get_create(key);
+        if (!slot)
+            return this->fail();
+        // A repeated key replaces the earlier value
+        slot->free_parsed();
+        *slot = Value();
+        slots[depth - 1] = slot;
+        state = STATE_COLON;
+        return true;
+    }
+    if (parseToken(&value, token, token_length, false, options))
+        return this->fail();
+    if (!this->attach(value))
+    {
+        value.free_parsed();
+        return this->fail();
+    }
+    state = depth ? STATE_NEXT : STATE_DONE;
+    return true;
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Byte scanning kernels for the buffer parser and the encoder. Host builds
+ * test 16 or 32 bytes per step with SSE2, AVX2 or NEON; everything else,
+ * AVR included, uses the plain byte loops. Define JSON_NO_SIMD to force
+ * the scalar versions. */
+
+#if !defined(JSON_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define JSON_SIMD_AVX2
+#elif !defined(JSON_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define JSON_SIMD_SSE2
+#elif !defined(JSON_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define JSON_SIMD_NEON
+#endif
+
+// scanEscape reads whole aligned blocks, which may extend past the string
+// but never across a page; keep the address sanitizer from objecting.
+#if defined(__GNUC__) || defined(__clang__)
+#define JSON_NO_SANITIZE __attribute__((no_sanitize_address))
+#else
+#define JSON_NO_SANITIZE
+#endif
+
+namespace Json {
+
+    inline bool isWhitespace(unsigned char ch) { return ch <= 32; }
+    inline bool isStringSpecial(unsigned char ch) { return ch == '\"' || ch == '\\' || ch < 32; }
+
+#if defined(JSON_SIMD_AVX2)
+    #define JSON_SIMD_WIDTH 32
+    typedef __m256i simd_t;
+    inline simd_t simdLoad(const char *p) { return _mm256_loadu_si256((const __m256i *)p); }
+    JSON_NO_SANITIZE inline simd_t simdLoadAligned(const char *p) { return _mm256_load_si256((const __m256i *)p); }
+    // Bytes that are not whitespace (> 32)
+    inline uint32_t simdNonWhitespace(simd_t x) {
+        simd_t ws = _mm256_cmpeq_epi8(_mm256_subs_epu8(x, _mm256_set1_epi8(32)), _mm256_setzero_si256());
+        return ~(uint32_t)_mm256_movemask_epi8(ws);
+    }
+    // Quotes, backslashes and control characters
+    inline uint32_t simdSpecial(simd_t x) {
+        simd_t quote = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\"'));
+        simd_t slash = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\\'));
+        simd_t ctrl = _mm256_cmpeq_epi8(_mm256_subs_epu8(x, _mm256_set1_epi8(31)), _mm256_setzero_si256());
+        return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(quote, slash), ctrl));
+    }
+    inline unsigned simdFirst(uint32_t mask) { return __builtin_ctz(mask); }
+#elif defined(JSON_SIMD_SSE2)
+    #define JSON_SIMD_WIDTH 16
+    typedef __m128i simd_t;
+    inline simd_t simdLoad(const char *p) { return _mm_loadu_si128((const __m128i *)p); }
+    JSON_NO_SANITIZE inline simd_t simdLoadAligned(const char *p) { return _mm_load_si128((const __m128i *)p); }
+    inline uint32_t simdNonWhitespace(simd_t x) {
+        simd_t ws = _mm_cmpeq_epi8(_mm_subs_epu8(x, _mm_set1_epi8(32)), _mm_setzero_si128());
+        return ~(uint32_t)_mm_movemask_epi8(ws) & 0xFFFF;
+    }
+    inline uint32_t simdSpecial(simd_t x) {
+        simd_t quote = _mm_cmpeq_epi8(x, _mm_set1_epi8('\"'));
+        simd_t slash = _mm_cmpeq_epi8(x, _mm_set1_epi8('\\'));
+        simd_t ctrl = _mm_cmpeq_epi8(_mm_subs_epu8(x, _mm_set1_epi8(31)), _mm_setzero_si128());
+        return (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(quote, slash), ctrl));
+    }
+    inline unsigned simdFirst(uint32_t mask) { return __builtin_ctz(mask); }
+#elif defined(JSON_SIMD_NEON)
+    #define JSON_SIMD_WIDTH 16
+    typedef uint8x16_t simd_t;
+    inline simd_t simdLoad(const char *p) { return vld1q_u8((const uint8_t *)p); }
+    JSON_NO_SANITIZE inline simd_t simdLoadAligned(const char *p) { return vld1q_u8((const uint8_t *)p); }
+    // NEON has no movemask; narrow each byte of the comparison to a nibble
+    inline uint64_t simdMask(uint8x16_t cmp) {
+        return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4)), 0);
+    }
+    inline uint64_t simdNonWhitespace(simd_t x) {
+        return simdMask(vcgtq_u8(x, vdupq_n_u8(32)));
+    }
+    inline uint64_t simdSpecial(simd_t x) {
+        uint8x16_t quote = vceqq_u8(x, vdupq_n_u8('\"'));
+        uint8x16_t slash = vceqq_u8(x, vdupq_n_u8('\\'));
+        uint8x16_t ctrl = vcltq_u8(x, vdupq_n_u8(32));
+        return simdMask(vorrq_u8(vorrq_u8(quote, slash), ctrl));
+    }
+    inline unsigned simdFirst(uint64_t mask) { return __builtin_ctzll(mask) >> 2; }
+#endif
+
+    // First non-whitespace byte in [p, end), or end.
+    inline const char *skipWhitespace(const char *p, const char *end) {
+        // Most tokens are separated by at most a space, check that first
+        if(p < end && !isWhitespace(*p))
+            return p;
+#ifdef JSON_SIMD_WIDTH
+        while(end - p >= JSON_SIMD_WIDTH) {
+            auto mask = simdNonWhitespace(simdLoad(p));
+            if(mask)
+                return p + simdFirst(mask);
+            p += JSON_SIMD_WIDTH;
+        }
+#endif
+        while(p < end && isWhitespace(*p))
+            p++;
+        return p;
+    }
+
+    // First quote, backslash or control character in [p, end), or end.
+    inline const char *scanString(const char *p, const char *end) {
+#ifdef JSON_SIMD_WIDTH
+        while(end - p >= JSON_SIMD_WIDTH) {
+            auto mask = simdSpecial(simdLoad(p));
+            if(mask)
+                return p + simdFirst(mask);
+            p += JSON_SIMD_WIDTH;
+        }
+#endif
+        while(p < end && !isStringSpecial(*p))
+            p++;
+        return p;
+    }
+
+    // First character of the NUL-terminated s that the encoder has to
+    // escape. The terminator is a control character, so it also stops here.
+    JSON_NO_SANITIZE inline const char *scanEscape(const char *s) {
+#ifdef JSON_SIMD_WIDTH
+        while((uintptr_t)s % JSON_SIMD_WIDTH) {
+            if(isStringSpecial(*s))
+                return s;
+            s++;
+        }
+        for(;;) {
+            auto mask = simdSpecial(simdLoadAligned(s));
+            if(mask)
+                return s + simdFirst(mask);
+            s += JSON_SIMD_WIDTH;
+        }
+#else
+        while(!isStringSpecial(*s))
+            s++;
+        return s;
+#endif
+    }
+
+    // Decode the escapes of the raw string [in, end) into out, which may be
+    // the same memory as in. Returns the end of the output or NULL if
+    // malformed. Defined with the buffer parser.
+    char *unescape(const char *in, const char *end, char *out);
+
+    //Most bytes one escape decodes to: a lone high surrogate, 3 bytes,
+    //followed by another escape that is not its low half
+    #define JSON_ESCAPE_MAX_BYTES 6
+
+    // Write code as UTF-8, returning the end of the output
+    char *writeUtf8(char *out, long code);
+
+    inline int hexValue(int in) {
+        if(in >= '0' && in <= '9')
+            return in - '0';
+        if(in >= 'a' && in <= 'f')
+            return in - 'a' + 10;
+        if(in >= 'A' && in <= 'F')
+            return in - 'A' + 10;
+        return -1;
+    }
+}
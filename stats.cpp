@@ -0,0 +1,52 @@
+#include "stats.h"
+
+#ifdef JSON_STATS
+
+using namespace Json;
+
+Stats Json::stats;
+
+void Stats::reset() {
+    allocations = frees = list_grows = 0;
+    peak_bytes = live_bytes;
+    bytes_parsed = nodes = 0;
+    max_depth = depth;
+    parse_micros = print_micros = 0;
+}
+
+static void track(size_t added, size_t removed) {
+    stats.live_bytes += added - removed;
+    if(stats.live_bytes > stats.peak_bytes)
+        stats.peak_bytes = stats.live_bytes;
+}
+
+void *Json::heapAlloc(size_t size) {
+    void *ptr = stats.alloc_hook ? stats.alloc_hook(size) : malloc(size);
+    if(ptr) {
+        stats.allocations++;
+        track(size, 0);
+    }
+    return ptr;
+}
+
+void *Json::heapRealloc(void *ptr, size_t old_size, size_t size) {
+    void *grown = stats.realloc_hook ? stats.realloc_hook(ptr, size) : realloc(ptr, size);
+    if(grown) {
+        stats.allocations++;
+        track(size, ptr ? old_size : 0);
+    }
+    return grown;
+}
+
+void Json::heapFree(void *ptr, size_t size) {
+    if(!ptr)
+        return;
+    stats.frees++;
+    track(0, size);
+    if(stats.free_hook)
+        stats.free_hook(ptr);
+    else
+        free(ptr);
+}
+
+#endif
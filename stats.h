@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#ifdef JSON_STATS
+#include <Arduino.h>
+#endif
+
+namespace Json {
+
+#ifdef JSON_STATS
+    /* Counters the library keeps in Json::stats when built with JSON_STATS
+     * defined, cheap enough to leave on in the field and export from a
+     * device. Byte counts are the sizes the library asked for. */
+    struct Stats {
+        uint32_t allocations;  // heap blocks allocated or reallocated
+        uint32_t frees;
+        uint32_t list_grows;   // AList::append moving to a bigger block
+        size_t live_bytes;     // heap held by the library right now
+        size_t peak_bytes;     // highest live_bytes since reset()
+        uint32_t bytes_parsed;
+        uint32_t nodes;        // values the parsers created
+        uint16_t depth;        // nesting of the parse in progress
+        uint16_t max_depth;    // deepest nesting parsed
+        uint32_t parse_micros; // time spent in parse and print calls
+        uint32_t print_micros;
+
+        // The heap the library uses when set, in place of malloc, realloc
+        // and free; set them before anything is allocated
+        void *(*alloc_hook)(size_t size);
+        void *(*realloc_hook)(void *ptr, size_t size);
+        void (*free_hook)(void *ptr);
+
+        // Zero the counters; live_bytes and the hooks are kept
+        void reset();
+    };
+    extern Stats stats;
+
+    // Adds the time until it goes out of scope to one of the totals.
+    class StatsTimer {
+    public:
+        StatsTimer(uint32_t &total) : total(total), start(micros()) {}
+        ~StatsTimer() { total += micros() - start; }
+    private:
+        uint32_t &total;
+        unsigned long start;
+    };
+
+    // Counts one level of nesting while it is in scope.
+    class StatsDepth {
+    public:
+        StatsDepth() {
+            if(++stats.depth > stats.max_depth)
+                stats.max_depth = stats.depth;
+        }
+        ~StatsDepth() { stats.depth--; }
+    };
+
+    void *heapAlloc(size_t size);
+    void *heapRealloc(void *ptr, size_t old_size, size_t size);
+    void heapFree(void *ptr, size_t size);
+#else
+    /* Every heap block the library owns goes through these. The size
+     * passed to heapFree is what was requested for the block. */
+    inline void *heapAlloc(size_t size) { return malloc(size); }
+    inline void *heapRealloc(void *ptr, size_t old_size, size_t size) { return realloc(ptr, size); }
+    inline void heapFree(void *ptr, size_t size) { free(ptr); }
+#endif
+}
@@ -0,0 +1,64 @@
+#include "test.h"
+#include "bind.h"
+
+struct Position {
+    int x;
+    double y;
+};
+JSON_BIND(Position, x, y)
+
+struct Reading {
+    long id;
+    float temp;
+    char unit[6];
+    bool ok;
+    Position at;
+    unsigned char small;
+    char a_rather_long_member_name_over_32[4];
+};
+JSON_BIND(Reading, id, temp, unit, ok, at, small, a_rather_long_member_name_over_32)
+
+// bind.h leaves names like this one free for the application
+struct Writer {
+    char name[16];
+    int books;
+};
+JSON_BIND(Writer, name, books)
+
+// A key that shares this name's first chunk and FNV-1a hash
+struct Crafted {
+    int a_member_name_longer_than_a_chunwqqqzka;
+};
+JSON_BIND(Crafted, a_member_name_longer_than_a_chunwqqqzka)
+
+TEST(bind_struct) {
+    Reading r;
+    memset(&r, 0, sizeof(r));
+    r.at.x = 7;
+    Json::aJsonStringStream in("{\"id\": 12, \"skip\": {\"deep\": [1, {\"a\": \"a string well past the thirty two byte chunk\"}]},"
+                               " \"temp\": 21.5, \"unit\": \"celsius-long\", \"ok\": true, \"at\": {\"y\": 2.5, \"x\": null},"
+                               " \"small\": \"wrong\", \"a_rather_long_member_name_over_32\": \"abc\","
+                               " \"a_rather_long_member_name_over_32x\": \"no\"}");
+    CHECK(Json::parseBound(in, r) == 0);
+    Json::DynamicBuffer out;
+    Json::printBound(r, out);
+    CHECK_STR(out.c_str(), "{\"id\":12,\"temp\":21.5,\"unit\":\"celsi\",\"ok\":true,\"at\":{\"x\":7,\"y\":2.5},\"small\":0,"
+                           "\"a_rather_long_member_name_over_32\":\"abc\"}");
+    Json::aJsonStringStream bad("{\"id\": 1,");
+    CHECK(Json::parseBound(bad, r) == EOF);
+    Json::aJsonStringStream two("{\"id\": 3} {\"id\": 4}");
+    CHECK(Json::parseBound(two, r) == 0 && r.id == 3);
+    CHECK(Json::parseBound(two, r) == 0 && r.id == 4);
+    Writer w;
+    Json::aJsonStringStream author("{\"books\": 3, \"name\": \"Ann\"}");
+    CHECK(Json::parseBound(author, w) == 0);
+    out.clear();
+    Json::printBound(w, out);
+    CHECK_STR(out.c_str(), "{\"name\":\"Ann\",\"books\":3}");
+    // Keys are compared in full, not by the hash of what follows the first chunk
+    Crafted c = { 1 };
+    Json::aJsonStringStream crafted("{\"a_member_name_longer_than_a_chunvxaeavg\": 5}");
+    CHECK(Json::parseBound(crafted, c) == 0 && c.a_member_name_longer_than_a_chunwqqqzka == 1);
+    Json::aJsonStringStream named("{\"a_member_name_longer_than_a_chunwqqqzka\": 5}");
+    CHECK(Json::parseBound(named, c) == 0 && c.a_member_name_longer_than_a_chunwqqqzka == 5);
+}
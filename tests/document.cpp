@@ -0,0 +1,86 @@
+#include <stdlib.h>
+#include "test.h"
+
+TEST(document_tape) {
+    Json::Document doc;
+    const char *text = "{\"name\":\"dev\\u00e9\",\"routes\":[{\"to\":\"a\",\"hops\":[1,2,3]},{\"to\":\"b\",\"hops\":[]}],"
+                       "\"big\":12345678901234,\"f\":-0.5,\"on\":true,\"off\":false,\"nil\":null,\"e\":{}}";
+    CHECK(doc.parse(text) == 0);
+    Json::Cursor r = doc.root();
+    CHECK(r.isObject() && r.size() == 8);
+    CHECK_STR(r["name"].asString(), "dev\xc3\xa9");
+    CHECK(r["name"].length() == 5);
+    CHECK(r["routes"].size() == 2 && r["routes"][1]["to"].asString()[0] == 'b' && r["routes"][0]["hops"][2].asInt() == 3);
+    CHECK(r["big"].asInt64() == 12345678901234LL && r["f"].asDouble() == -0.5);
+    CHECK(r["on"].asBool() && !r["off"].asBool() && r["nil"].isNull());
+    CHECK(r["e"].isObject() && r["e"].size() == 0 && r["e"].first().isInvalid());
+    CHECK(r["missing"].isInvalid() && r["routes"][5].isInvalid() && r["missing"]["x"].asInt() == 0);
+    char keys[100] = "";
+    for(Json::Cursor c = r.first(); !c.isInvalid(); c = c.next()) {
+        strcat(keys, c.key());
+        strcat(keys, ",");
+    }
+    CHECK_STR(keys, "name,routes,big,f,on,off,nil,e,");
+    // Only member values have keys, whatever raw number bits precede them
+    CHECK(doc.parse("[1e-28, 5, {\"k\":[1.5e-300, \"s\"]}]") == 0);
+    CHECK(doc.root().key() == NULL && doc.root()[1].key() == NULL && doc.root()[2].key() == NULL);
+    CHECK_STR(doc.root()[2]["k"].key(), "k");
+    CHECK(doc.root()[2]["k"][1].key() == NULL && doc.root()[2]["k"][1].isString());
+    CHECK(doc.parse("[1,2") == EOF && doc.root().isInvalid());
+    CHECK(doc.parse("[1] x") == EOF);
+    CHECK(doc.parse(" \"s\" ") == 0 && doc.root().isString() && doc.root().next().isInvalid());
+    // Nesting is bounded by JSON_DOCUMENT_MAX_DEPTH, not by the stack
+    size_t n = 1000000;
+    char *deep = (char*) malloc(n);
+    memset(deep, '[', n);
+    CHECK(doc.parse(deep, n) == EOF && doc.root().isInvalid());
+    memset(deep + JSON_DOCUMENT_MAX_DEPTH, ']', JSON_DOCUMENT_MAX_DEPTH);
+    CHECK(doc.parse(deep, 2 * JSON_DOCUMENT_MAX_DEPTH) == 0);
+    deep[JSON_DOCUMENT_MAX_DEPTH] = '[';
+    CHECK(doc.parse(deep, 2 * JSON_DOCUMENT_MAX_DEPTH + 1) == EOF);
+    free(deep);
+}
+
+TEST(document_lazy) {
+    Json::LazyDocument doc;
+    const char *text = "{\"a\":{\"x\":[1,{\"deep\":true}],\"y\":\"s\"},\"b\":[[1],[2,3]],\"c\":5}";
+    CHECK(doc.parse(text) == 0);
+    Json::Value r = doc.root();
+    CHECK(r.type == JSON_LAZY && r.isObject() && !r.isArray());
+    CHECK_STR(show(r), text);
+    Json::Object &o = r.asObject();
+    CHECK(o["c"].asInt() == 5 && o["a"].type == JSON_LAZY && o["b"].type == JSON_LAZY);
+    CHECK(o["b"].asArray()[1].asArray()[1].asInt() == 3);
+    CHECK(o["a"].asObject()["x"].asArray()[1].asObject()["deep"].asBool());
+    o["c"] = 6;
+    CHECK_STR(show(doc.root()), "{\"a\":{\"x\":[1,{\"deep\":true}],\"y\":\"s\"},\"b\":[[1],[2,3]],\"c\":6}");
+    CHECK(doc.parse("{\"a\":[1,}") == EOF && doc.root().isInvalid());
+    CHECK(doc.parse("[\"\\u12g4\"]") == EOF);
+    CHECK(doc.parse(" \"str\" ") == 0);
+    Json::Value scalar = doc.root();
+    CHECK_STR(scalar.asString(), "str");
+    CHECK(doc.parse("[]") == 0 && doc.root().asArray().size() == 0);
+    // A lookup parses only the member asked for
+    CHECK(doc.parse("{\"id\":12,\"name\":\"a long name \\u00e9\",\"on\":true,\"list\":[1,\"two\"],\"f\":2.5}") == 0);
+    Json::Object &m = doc.root().asObject();
+    CHECK(m.size() == 5 && m["id"].type == JSON_LAZY && m["name"].type == JSON_LAZY && m["f"].type == JSON_LAZY);
+    CHECK_STR(m["name"].asString(), "a long name \xc3\xa9");
+    CHECK(m["name"].type == JSON_STRING && m["id"].type == JSON_LAZY && m["on"].type == JSON_LAZY);
+    CHECK(m["f"].asDouble() == 2.5 && m["on"].isBool() && !m["list"].isString() && m["list"].type == JSON_LAZY);
+    CHECK_STR(show(doc.root()), "{\"id\":12,\"name\":\"a long name \xc3\xa9\",\"on\":true,\"list\":[1,\"two\"],\"f\":2.5}");
+    Json::Value copy(m.clone());
+    CHECK(copy.asObject()["id"].type == JSON_INT);
+    doc.clear();
+    CHECK_STR(show(copy), "{\"id\":12,\"name\":\"a long name \xc3\xa9\",\"on\":true,\"list\":[1,\"two\"],\"f\":2.5}");
+    copy.free_parsed();
+    // Nesting is bounded by JSON_PARSE_MAX_DEPTH, not by the stack
+    size_t n = 1000000;
+    char *deep = (char*) malloc(n);
+    memset(deep, '[', n);
+    CHECK(doc.parse(deep, n) == EOF);
+    memset(deep + JSON_PARSE_MAX_DEPTH, ']', JSON_PARSE_MAX_DEPTH);
+    CHECK(doc.parse(deep, 2 * JSON_PARSE_MAX_DEPTH) == 0 && doc.root().asArray()[0].isArray());
+    deep[JSON_PARSE_MAX_DEPTH] = '[';
+    CHECK(doc.parse(deep, 2 * JSON_PARSE_MAX_DEPTH + 1) == EOF);
+    free(deep);
+}
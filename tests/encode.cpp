@@ -0,0 +1,132 @@
+#include <math.h>
+#include <stdlib.h>
+#include "test.h"
+
+TEST(encode_shortest_doubles) {
+    const double cases[] = { 0.1, 1.5, -2.5, 100.0, 1e15, 1e16, 1e21, 1e22, 1e23, 123456.789, 0.001, 0.0001, 1e-5,
+                             5e-324, 2.2250738585072014e-308, 1.7976931348623157e308, 0.30000000000000004, -0.0 };
+    const char *text[] = { "0.1", "1.5", "-2.5", "100.0", "1e15", "1e16", "1e21", "1e22", "9.999999999999999e22",
+                           "123456.789", "0.001", "0.0001", "0.00001", "5e-324", "2.2250738585072014e-308",
+                           "1.7976931348623157e308", "0.30000000000000004", "-0.0" };
+    for(int i = 0; i < 18; i++)
+        CHECK_STR(show(Json::Value(cases[i])), text[i]);
+    CHECK_STR(show(Json::Value(NAN)), "null");
+    CHECK_STR(show(Json::Value(-INFINITY)), "null");
+    // Random bit patterns print back to the same double
+    unsigned long long seed = 12345;
+    int wrong = 0;
+    for(int i = 0; i < 100000; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double d;
+        memcpy(&d, &seed, sizeof(d));
+        if(d != d || isinf(d))
+            continue;
+        wrong += strtod(show(Json::Value(d)), NULL) != d;
+    }
+    CHECK(wrong == 0);
+}
+
+TEST(encode_writer) {
+    static char doc[4000];
+    strcpy(doc, "[");
+    for(int i = 0; i < 200; i++)
+        sprintf(doc + strlen(doc), "%s%d.25", i ? "," : "", i);
+    strcat(doc, ",\"");
+    for(int i = 0; i < 600; i++)
+        strcat(doc, i % 50 ? "x" : "\\n");
+    strcat(doc, "\"]");
+    Json::Value v = Json::parse(doc);
+    CHECK_STR(show(v), doc);
+    static char out[4000];
+    Json::aJsonStringStream whole(NULL, out, sizeof(out));
+    CHECK(Json::print(v, whole) == (int)strlen(doc));
+    CHECK_STR(out, doc);
+    char small[64];
+    Json::aJsonStringStream cut(NULL, small, sizeof(small));
+    Json::print(v, cut);
+    CHECK(strlen(small) == 63 && !strncmp(small, doc, 63));
+    v.free_parsed();
+}
+
+TEST(encode_dynamic_buffer) {
+    Json::Value v = Json::parse("{\"a\":[1,2,3,\"a long enough string to need growing past sixty-four bytes of room\"],\"b\":{\"c\":null}}");
+    size_t length;
+    char *text = Json::dumpToString(v, &length);
+    CHECK_STR(text, "{\"a\":[1,2,3,\"a long enough string to need growing past sixty-four bytes of room\"],\"b\":{\"c\":null}}");
+    CHECK(length == strlen(text) && (int)length == Json::measure(v));
+    free(text);
+    Json::DynamicBuffer buffer;
+    Json::print(v, buffer);
+    size_t capacity = buffer.capacity();
+    buffer.clear();
+    Json::print(v, buffer);
+    CHECK(buffer.capacity() == capacity && buffer.length() == length);
+    char arena_memory[512];
+    Json::Arena arena(arena_memory, sizeof(arena_memory));
+    Json::DynamicBuffer in_arena(0, &arena);
+    Json::print(v, in_arena);
+    CHECK_STR(in_arena.c_str(), buffer.c_str());
+    char small[10];
+    CHECK(Json::dump(v, small, sizeof(small)) == 9);
+    CHECK_STR(small, "{\"a\":[1,2");
+    text = Json::dumpToString(Json::Value());
+    CHECK_STR(text, "null");
+    free(text);
+    v.free_parsed();
+}
+
+TEST(encode_cbor) {
+    Bytes out;
+    Json::Value v = Json::parse("{\"a\":1,\"b\":[-1,-500,100000,5000000000,1.5,0.1,true,false,null],\"s\":\"hello\"}");
+    static const uint8_t expect[] = {
+        0xA3, 0x61, 'a', 0x01, 0x61, 'b', 0x89, 0x20, 0x39, 0x01, 0xF3, 0x1A, 0x00, 0x01, 0x86, 0xA0,
+        0x1B, 0x00, 0x00, 0x00, 0x01, 0x2A, 0x05, 0xF2, 0x00, 0xFA, 0x3F, 0xC0, 0x00, 0x00,
+        0xFB, 0x3F, 0xB9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A, 0xF5, 0xF4, 0xF6, 0x61, 's', 0x65, 'h', 'e', 'l', 'l', 'o' };
+    CHECK(Json::printCbor(v, out) == (int)sizeof(expect));
+    CHECK(out.size == sizeof(expect) && !memcmp(out.data(), expect, sizeof(expect)));
+    Json::Value back = Json::parseCbor(out.data(), out.size);
+    CHECK_STR(show(back), "{\"a\":1,\"b\":[-1,-500,100000,5000000000,1.5,0.1,true,false,null],\"s\":\"hello\"}");
+    back.free_parsed();
+    v.free_parsed();
+    // Indefinite containers, tags and half floats
+    static const uint8_t indefinite[] = { 0xBF, 0x61, 'k', 0x9F, 0xF9, 0x3C, 0x00, 0xF9, 0xC4, 0x00, 0xC1, 0x01, 0xFF,
+                                          0x61, 'z', 0x80, 0xFF };
+    back = Json::parseCbor(indefinite, sizeof(indefinite));
+    CHECK_STR(show(back), "{\"k\":[1.0,-4.0,1],\"z\":[]}");
+    back.free_parsed();
+    static const uint8_t int_key[] = { 0xA1, 0x01, 0x02 };
+    CHECK(Json::parseCbor(int_key, sizeof(int_key)).isInvalid());
+    static const uint8_t cut[] = { 0x82, 0x01, 0x63, 'a' };
+    CHECK(Json::parseCbor(cut, sizeof(cut)).isInvalid());
+    static const uint8_t bytes[] = { 0x42, 'h', 'i' }, bytes_key[] = { 0xA1, 0x41, 'k', 0x01 };
+    CHECK(Json::parseCbor(bytes, sizeof(bytes)).isInvalid() && Json::parseCbor(bytes_key, sizeof(bytes_key)).isInvalid());
+    // Runs of tags and deep nesting stop without exhausting the stack
+    static uint8_t deep[200001];
+    memset(deep, 0xC0, sizeof(deep) - 1);
+    deep[sizeof(deep) - 1] = 0x07;
+    back = Json::parseCbor(deep, sizeof(deep));
+    CHECK(back.asInt() == 7);
+    CHECK(Json::parseCbor(deep, sizeof(deep) - 1).isInvalid());
+    memset(deep, 0x81, sizeof(deep) - 1);
+    CHECK(Json::parseCbor(deep, sizeof(deep)).isInvalid());
+    back = Json::parseCbor(deep + sizeof(deep) - 1 - JSON_CBOR_MAX_DEPTH, JSON_CBOR_MAX_DEPTH + 1);
+    CHECK(back.isArray());
+    back.free_parsed();
+    memset(deep, 0xBF, sizeof(deep));
+    CHECK(Json::parseCbor(deep, sizeof(deep)).isInvalid());
+    // A declared length is not allocated before the bytes arrive
+    static const uint8_t huge[] = { 0x7B, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0, 'a', 'b', 'c' };
+    CHECK(Json::parseCbor(huge, sizeof(huge)).isInvalid());
+    deep[0] = 0x79;
+    deep[1] = 0x03;
+    deep[2] = 0xE8;
+    memset(deep + 3, 'x', 1000);
+    back = Json::parseCbor(deep, 1003);
+    CHECK(back.isString() && strlen(back.asString()) == 1000 && back.asString()[999] == 'x');
+    back.free_parsed();
+    CHECK(Json::parseCbor(deep, 1002).isInvalid());
+    static const uint8_t nul[] = { 0x6A, 'n', 'u', 'l', 0, 'l', 'o', 'n', 'g', 'e', 'r' };
+    back = Json::parseCbor(nul, sizeof(nul));
+    CHECK_STR(back.asString(), "nul");
+    back.free_parsed();
+}
@@ -0,0 +1,30 @@
+#include "test.h"
+
+int test_failures = 0;
+
+static TestCase *cases = NULL;
+
+TestCase::TestCase(const char *name, void (*run)()) : name(name), run(run), next(cases) {
+    cases = this;
+}
+
+const char *show(Json::Value value) {
+    static Json::DynamicBuffer out;
+    out.clear();
+    Json::print(value, out);
+    return out.c_str();
+}
+
+int main(int argc, char **argv) {
+    int ran = 0;
+    for(TestCase *test = cases; test; test = test->next) {
+        if(argc > 1 && strncmp(test->name, argv[1], strlen(argv[1])))
+            continue;
+        int before = test_failures;
+        test->run();
+        printf("%-24s %s\n", test->name, test_failures == before ? "ok" : "FAILED");
+        ran++;
+    }
+    printf("%d tests, %d failed checks\n", ran, test_failures);
+    return test_failures != 0 || ran == 0;
+}
@@ -0,0 +1,133 @@
+#include "test.h"
+
+TEST(object_index) {
+    // Past AMAP_INDEX_THRESHOLD lookups go through the hash index
+    Json::Object o;
+    char key[16];
+    for(int i = 0; i < 500; i++) {
+        sprintf(key, "k%d", i);
+        o[key] = i;
+    }
+    for(int i = 0; i < 500; i += 3) {
+        sprintf(key, "k%d", i);
+        CHECK(o.remove(key));
+    }
+    for(int i = 0; i < 500; i += 6) {
+        sprintf(key, "k%d", i);
+        o[key] = -i;
+    }
+    for(int i = 0; i < 500; i++) {
+        sprintf(key, "k%d", i);
+        Json::Value *v = o.get(key);
+        if(i % 6 == 0)
+            CHECK(v && v->asInt() == -i);
+        else if(i % 3 == 0)
+            CHECK(v == NULL);
+        else
+            CHECK(v && v->asInt() == i);
+    }
+    Json::Object *c = o.clone();
+    CHECK(c->get("k499") && !c->get("k3"));
+    delete c;
+    // A repeated key in a large document replaces the first
+    static char big[8000];
+    strcpy(big, "{");
+    for(int i = 0; i < 300; i++)
+        sprintf(big + strlen(big), "%s\"key%d\":%d", i ? "," : "", i, i);
+    strcat(big, ",\"key7\":\"dup\"}");
+    Json::Value v = Json::parse(big);
+    CHECK(v.asObject().size() == 300);
+    CHECK_STR(v.asObject().get("key7")->asString(), "dup");
+    v.free_parsed();
+}
+
+TEST(object_key_table) {
+    static const char *const seeds[] = { "id", "ts", "value", "type" };
+    Json::KeyTable table(6, seeds, 4);
+    Json::ParseOptions options;
+    options.keys = &table;
+    const char *doc = "{\"id\":1,\"ts\":2,\"value\":3,\"extra\":4,\"more\":5,\"a\\u0041\":6,\"yet\":7,\"and\":8}";
+    Json::Value v = Json::parse(doc, options);
+    CHECK_STR(show(v), "{\"id\":1,\"ts\":2,\"value\":3,\"extra\":4,\"more\":5,\"aA\":6,\"yet\":7,\"and\":8}");
+    Json::Key value = table.find("value");
+    Json::Object &o = v.asObject();
+    CHECK(o.get(value)->asInt() == 3 && o.get("more")->asInt() == 5 && o.has(table.find("extra")));
+    CHECK(table.size() == 6);
+    CHECK(o.get(2).key == value.str);
+    Json::Object *c = o.clone();
+    CHECK(c->get(value)->asInt() == 3);
+    delete c;
+    v.free_parsed();
+    Json::aJsonStringStream in(doc);
+    in.options = options;
+    CHECK(in.parseValue(&v, NULL) == 0);
+    CHECK(v.asObject().get(table.find("ts"))->asInt() == 2);
+    v.free_parsed();
+    char buf[200];
+    strcpy(buf, doc);
+    v = Json::parseInSitu(buf, strlen(buf), options);
+    CHECK(v.asObject().get(table.find("ts"))->asInt() == 2 && v.asObject().get("and")->asInt() == 8);
+    v.free_parsed();
+    // A key from another table finds the member by its text
+    v = Json::parse(doc, options);
+    Json::KeyTable other(4, seeds, 4);
+    CHECK(v.asObject().get(other.find("value"))->asInt() == 3);
+    v.asObject().set(other.find("value"), Json::OwnedValue(Json::Value(30)));
+    CHECK(v.asObject().size() == 8 && v.asObject().get("value")->asInt() == 30);
+    v.free_parsed();
+}
+
+TEST(object_remove) {
+    Json::Value v = Json::parse("{\"a\":\"a long string value one\",\"b\":[1,2],\"c\":3}");
+    Json::Object &o = v.asObject();
+    CHECK(o.remove("a") && !o.remove("a") && o.size() == 2);
+    CHECK_STR(show(v), "{\"c\":3,\"b\":[1,2]}");
+    o.remove("c");
+    CHECK_STR(show(v), "{\"b\":[1,2]}");
+    o["d"] = Json::Value(4);
+    CHECK_STR(show(v), "{\"b\":[1,2],\"d\":4}");
+    v.free_parsed();
+}
+
+TEST(object_remove_ordered) {
+    Json::Object ordered;
+    ordered.keep_order = true;
+    char key[16];
+    for(int i = 0; i < 40; i++) {
+        sprintf(key, "key%d", i);
+        ordered.set(key, Json::Value(i));
+    }
+    for(int i = 0; i < 40; i += 2) {
+        sprintf(key, "key%d", i);
+        CHECK(ordered.remove(key));
+    }
+    for(int i = 1; i < 40; i += 2) {
+        sprintf(key, "key%d", i);
+        Json::Value *member = ordered.get(key);
+        CHECK(member && member->asInt() == i);
+    }
+    CHECK(ordered.size() == 20 && !ordered.has("key0"));
+    CHECK(!strncmp(show(Json::Value(&ordered)), "{\"key1\":1,\"key3\":3,", 19));
+    Json::Object *copy = ordered.clone();
+    CHECK(copy->size() == 20);
+    delete copy;
+}
+
+TEST(object_remove_churn) {
+    // Keys added and removed forever must not grow the map
+    Json::Object churn;
+    char key[16];
+    for(int i = 0; i < 5000; i++) {
+        sprintf(key, "k%d", i);
+        churn.set(key, Json::Value("a string too long to be inline"));
+        if(i >= 20) {
+            sprintf(key, "k%d", i - 20);
+            CHECK(churn.remove(key));
+        }
+    }
+    CHECK(churn.size() == 20 && churn._size <= 64);
+    for(int i = 4980; i < 5000; i++) {
+        sprintf(key, "k%d", i);
+        CHECK(churn.has(key));
+    }
+}
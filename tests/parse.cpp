@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include "test.h"
+
+TEST(parse_buffer) {
+    Json::Value v = Json::parse("{\"key\":[1,\"2\",{\"3\":true}], \"f\": 1.5, \"s\":\"a\\\"b\\n\", \"n\":null, \"neg\":-12}");
+    CHECK_STR(show(v), "{\"key\":[1,\"2\",{\"3\":true}],\"f\":1.5,\"s\":\"a\\\"b\\n\",\"n\":null,\"neg\":-12}");
+    v.free_parsed();
+    // Only the first len bytes are read; a repeated key replaces the first
+    const char *doc = "{\"k\\\"ey\":\"v\\u0041l\",\"k\\\"ey\":2, \"arr\":[[],{},\"\"]} trailing";
+    v = Json::parse(doc, 54);
+    CHECK_STR(show(v), "{\"k\\\"ey\":2,\"arr\":[[],{},\"\"]}");
+    v.free_parsed();
+    // parse() keeps what it read of a broken document; parseToken() fails
+    v = Json::parse("{\"a\":[1,2");
+    v.free_parsed();
+    char cut[] = "{\"a\":[1,2", colon[] = "{\"a\" 1}";
+    CHECK(Json::parseToken(&v, cut, strlen(cut), false, Json::ParseOptions()) == EOF && v.isInvalid());
+    CHECK(Json::parseToken(&v, colon, strlen(colon), true, Json::ParseOptions()) == EOF);
+    char escape[] = "[\"a\\qb\"]";
+    CHECK(Json::parseToken(&v, escape, strlen(escape), false, Json::ParseOptions()) == EOF);
+    // Nesting is bounded by JSON_PARSE_MAX_DEPTH, not by the stack
+    size_t n = 1000000;
+    char *deep = (char*) malloc(n);
+    memset(deep, '[', n);
+    Json::parse(deep, n).free_parsed();
+    CHECK(Json::parseToken(&v, deep, n, false, Json::ParseOptions()) == EOF);
+    memset(deep + JSON_PARSE_MAX_DEPTH, ']', JSON_PARSE_MAX_DEPTH);
+    CHECK(Json::parseToken(&v, deep, 2 * JSON_PARSE_MAX_DEPTH, false, Json::ParseOptions()) == 0);
+    v.free_parsed();
+    deep[JSON_PARSE_MAX_DEPTH] = '[';
+    CHECK(Json::parseToken(&v, deep, 2 * JSON_PARSE_MAX_DEPTH + 1, false, Json::ParseOptions()) == EOF);
+    free(deep);
+}
+
+TEST(parse_in_situ) {
+    char doc[] = "{ \"id\" : \"a\\tb\\u00e9\\ud83d\\ude00\", \"list\": [1, -2.5, true, null, \"x\"], \"o\":{} }";
+    Json::Value v = Json::parseInSitu(doc, strlen(doc));
+    CHECK_STR(show(v), "{\"id\":\"a\\tb\xc3\xa9\xf0\x9f\x98\x80\",\"list\":[1,-2.5,true,null,\"x\"],\"o\":{}}");
+    const char *id = v.asObject().get("id")->asString();
+    CHECK(id > doc && id < doc + sizeof(doc));
+    // A clone copies strings out of the buffer
+    Json::Value copy(v.asObject().clone());
+    v.free_parsed();
+    CHECK_STR(show(copy), "{\"id\":\"a\\tb\xc3\xa9\xf0\x9f\x98\x80\",\"list\":[1,-2.5,true,null,\"x\"],\"o\":{}}");
+    copy.free_parsed();
+    char bad[] = "[1, \"abc";
+    Json::parseInSitu(bad, strlen(bad)).free_parsed();
+    CHECK(Json::parseToken(&v, bad, strlen(bad), true, Json::ParseOptions()) == EOF);
+}
+
+TEST(parse_stream) {
+    Json::aJsonStringStream in("{\"a\" : [1, \"b\"], \"c\":{\"d\":\"e\"}}");
+    Json::Value v;
+    CHECK(in.parseValue(&v, NULL) == 0);
+    CHECK_STR(show(v), "{\"a\":[1,\"b\"],\"c\":{\"d\":\"e\"}}");
+    v.free_parsed();
+}
+
+TEST(parse_long_keys) {
+    const char *doc = "{\"a_key_that_is_definitely_longer_than_sixty_four_characters_in_total_length\":1}";
+    Json::Value v = Json::parse(doc);
+    CHECK_STR(show(v), doc);
+    v.free_parsed();
+    Json::aJsonStringStream in(doc);
+    CHECK(in.parseValue(&v, NULL) == 0);
+    CHECK_STR(show(v), doc);
+    v.free_parsed();
+}
+
+TEST(parse_scanning) {
+    // Whitespace and strings long enough for the block scanners
+    char doc[2048];
+    strcpy(doc, "{\n");
+    for(int i = 0; i < 40; i++)
+        strcat(doc, " ");
+    strcat(doc, "\"a long key that spans more than one block\"   :\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t"
+                "\"0123456789012345678901234567890123456789\\\"0123456789012345678901234567890123\\n45\\\\xyz\"\n");
+    for(int i = 0; i < 70; i++)
+        strcat(doc, " ");
+    strcat(doc, "}");
+    Json::Value v = Json::parse(doc);
+    CHECK_STR(show(v), "{\"a long key that spans more than one block\":"
+                       "\"0123456789012345678901234567890123456789\\\"0123456789012345678901234567890123\\n45\\\\xyz\"}");
+    v.free_parsed();
+    // An escape at every offset within a block
+    for(int offset = 0; offset < 40; offset++) {
+        char text[48];
+        memset(text, 'x', offset);
+        strcpy(text + offset, "\n");
+        const char *printed = show(Json::Value::borrowed(text));
+        CHECK(strlen(printed) == (size_t)offset + 4 && !strcmp(printed + offset + 1, "\\n\""));
+    }
+}
+
+TEST(parse_numbers) {
+    Json::Value v = Json::parse("[9223372036854775807,-9223372036854775808,9223372036854775808,1700000000123,-0,"
+                                "0.1,1e22,1e23,2.2250738585072014e-308,123456789012345678901234567890,"
+                                "1.7976931348623157e308,5e-324,0.000001234]");
+    Json::Array &a = v.asArray();
+    CHECK_STR(show(a[0]), "9223372036854775807");
+    CHECK_STR(show(a[1]), "-9223372036854775808");
+    CHECK(a[2].isFloat() && a[2].asDouble() == 9223372036854775808.0);
+    CHECK(a[3].asInt64() == 1700000000123LL);
+    CHECK(a[4].isInt() && a[4].asInt64() == 0);
+    const double expect[] = { 0.1, 1e22, 1e23, 2.2250738585072014e-308, 123456789012345678901234567890.0,
+                              1.7976931348623157e308, 5e-324, 0.000001234 };
+    for(int i = 0; i < 8; i++)
+        CHECK(a[5 + i].asDouble() == expect[i]);
+    v.free_parsed();
+    Json::aJsonStringStream in("[12345678901234, 3.14159, -2e-3]");
+    CHECK(in.parseValue(&v, NULL) == 0);
+    CHECK(v.asArray()[0].asInt64() == 12345678901234LL);
+    CHECK(v.asArray()[1].asDouble() == 3.14159 && v.asArray()[2].asDouble() == -2e-3);
+    v.free_parsed();
+    const char *bad[] = { "-", "1.", "1e", "1.e5", "--1", "1e+", NULL };
+    for(int i = 0; bad[i]; i++) {
+        Json::Value b;
+        CHECK(Json::parseToken(&b, (char *)bad[i], strlen(bad[i]), false, Json::ParseOptions()) == EOF);
+    }
+}
+
+TEST(parse_arena) {
+    Json::Arena arena(64);
+    Json::ParseOptions options;
+    options.arena = &arena;
+    for(int round = 0; round < 3; round++) {
+        Json::Value v = Json::parse("{\"a\":[1,2,3,4,5,6,7,8,9,10],\"b\":{\"c\":\"hello world\"}}", options);
+        CHECK_STR(show(v), "{\"a\":[1,2,3,4,5,6,7,8,9,10],\"b\":{\"c\":\"hello world\"}}");
+        arena.reset();
+    }
+    // A fixed buffer that runs out stops the parse instead of overflowing
+    static char small[64];
+    Json::Arena fixed(small, sizeof(small));
+    options.arena = &fixed;
+    Json::Value v;
+    char text[] = "{\"a\":[1,2,3,4,5,6,7,8,9,10],\"b\":{\"c\":\"hello world\"}}";
+    CHECK(Json::parseToken(&v, text, strlen(text), false, options) == EOF);
+    static char big[4096];
+    Json::Arena roomy(big, sizeof(big));
+    options.arena = &roomy;
+    CHECK_STR(show(Json::parse("[\"x\",[true,false,null]]", options)), "[\"x\",[true,false,null]]");
+}
@@ -0,0 +1,59 @@
+#include "test.h"
+
+#ifdef JSON_STATS
+TEST(stats_counts) {
+    Json::stats.reset();
+    size_t base = Json::stats.live_bytes;
+    Json::Value v = Json::parse("{\"a\":[1,2,{\"b\":[\"a long string value\"]}],\"k\":\"short\"}");
+    CHECK(Json::stats.nodes == 8 && Json::stats.max_depth == 4 && Json::stats.bytes_parsed > 0);
+    CHECK(Json::stats.live_bytes > base && Json::stats.peak_bytes >= Json::stats.live_bytes);
+    Json::Value c(v.asObject().share());
+    c.asObject().edit("a")->asArray().append(Json::Value(3));
+    c.free_parsed();
+    v.free_parsed();
+    CHECK(Json::stats.live_bytes == base);
+    // Escaped strings are stored at their decoded length
+    v = Json::parse("[\"a \\u00e9 long escaped \\n string\",\"cut \\u0000 off here\"]");
+    CHECK_STR(v.asArray()[1].asString(), "cut ");
+    v.free_parsed();
+    CHECK(Json::stats.live_bytes == base);
+    {
+        Json::Document d;
+        d.parse("[1,[2,[3]]]");
+        Json::LazyDocument l;
+        l.parse("{\"x\":[1,2]}");
+        l.root().asObject()["x"].asArray();
+        Json::KeyTable keys(8);
+        keys.intern("name", 4);
+        d.parse("[]");
+        l.clear();
+        CHECK(Json::stats.frees > 0 && Json::stats.list_grows > 0 && Json::stats.depth == 0);
+    }
+    CHECK(Json::stats.live_bytes == base);
+}
+
+// Lets allocs_left more allocations through, then fails them
+static int allocs_left;
+static void *failingAlloc(size_t size) {
+    return allocs_left-- > 0 ? malloc(size) : NULL;
+}
+
+TEST(stats_clone_failure) {
+    const char *text = "{\"a\":[1,\"a long string value\",{\"b\":[\"another long string\"]}],\"key\":\"short\"}";
+    Json::Value v = Json::parse(text);
+    size_t base = Json::stats.live_bytes;
+    // A clone is either whole or NULL, and a failed one frees what it took
+    Json::Object *copy = NULL;
+    Json::stats.alloc_hook = failingAlloc;
+    for(int limit = 0; !copy; limit++) {
+        allocs_left = limit;
+        copy = v.asObject().clone();
+        CHECK(copy || Json::stats.live_bytes == base);
+    }
+    Json::stats.alloc_hook = NULL;
+    Json::Value c(copy);
+    CHECK_STR(show(c), text);
+    c.free_parsed();
+    v.free_parsed();
+}
+#endif
@@ -0,0 +1,121 @@
+#include "test.h"
+
+// The tokens of in as one line: K(key) S(string) N(number), + on a chunk
+// with more to follow
+static int tokenLog(Json::aJsonStream &in, char *log) {
+    Json::Token token;
+    int type;
+    *log = 0;
+    while((type = in.nextToken(&token)) > 0) {
+        if(type == JSON_TOKEN_KEY || type == JSON_TOKEN_STRING)
+            sprintf(log + strlen(log), "%c(%s%s)", type == JSON_TOKEN_KEY ? 'K' : 'S', token.chunk, token.more ? "+" : "");
+        else if(type == JSON_TOKEN_NUMBER)
+            sprintf(log + strlen(log), "N(%s)", show(token.value));
+        else
+            sprintf(log + strlen(log), "%c", "?{}[]KSNBn"[type]);
+    }
+    return type;
+}
+
+TEST(stream_tokens) {
+    Json::aJsonStringStream in("{\"k\": [1, -2.5, true, false, null, \"a string that is longer than thirty-two bytes for sure\", {}],"
+                               " \"e\\n\":{\"x\":[]}} [3]");
+    char log[1024];
+    CHECK(tokenLog(in, log) == JSON_TOKEN_END);
+    CHECK_STR(log, "{K(k)[N(1)N(-2.5)BBnS(a string that is longer than thi+)S(rty-two bytes for sure){}]K(e\n){K(x)[]}}");
+    // The next document follows
+    CHECK(tokenLog(in, log) == JSON_TOKEN_END);
+    CHECK_STR(log, "[N(3)]");
+    Json::aJsonStringStream bad("[1}");
+    CHECK(tokenLog(bad, log) == JSON_TOKEN_ERROR);
+    // Escapes decode to UTF-8, and one never straddles two chunks
+    Json::aJsonStringStream escapes("[\"a\\u00e9b\", \"\\ud83d\\ude00\\ud83d\\n\", \"0123456789012345678901234567\\u20ac\\u20acx\"]");
+    CHECK(tokenLog(escapes, log) == JSON_TOKEN_END);
+    CHECK_STR(log, "[S(a\xc3\xa9" "b)S(\xf0\x9f\x98\x80\xed\xa0\xbd\n)S(0123456789012345678901234567+)S(\xe2\x82\xac\xe2\x82\xacx)]");
+    Json::aJsonStringStream unknown("[\"a\\qb\"]");
+    CHECK(tokenLog(unknown, log) == JSON_TOKEN_ERROR);
+    Json::aJsonStringStream cut("[\"\\u00g0\"]");
+    CHECK(tokenLog(cut, log) == JSON_TOKEN_ERROR);
+    Json::Value v;
+    Json::aJsonStringStream value("{\"k\\u00e9\":\"\\ud83d\\ude00!\"}");
+    CHECK(value.parseValue(&v, NULL) == 0);
+    CHECK_STR(show(v), "{\"k\xc3\xa9\":\"\xf0\x9f\x98\x80!\"}");
+    v.free_parsed();
+    Json::aJsonStringStream invalid("{\"k\":\"\\x\"}");
+    CHECK(invalid.parseValue(&v, NULL) == EOF);
+    v.free_parsed();
+}
+
+TEST(stream_filter) {
+    const char *doc = "{\"meta\":{\"id\":7,\"name\":\"x\"},\"sensors\":[{\"temp\":1.5,\"hum\":[1,2,{\"z\":\"}]\"}]},{\"temp\":2,\"hum\":3}],"
+                      "\"skip\":{\"deep\":[[[\"a\\\"b\"]]],\"n\":null},\"e\\u0073c\":true,\"last\":\"s\"}";
+    const char *paths[] = { "meta.id", "sensors[*].temp", "esc", "last", NULL };
+    const char *expect = "{\"meta\":{\"id\":7},\"sensors\":[{\"temp\":1.5},{\"temp\":2}],\"esc\":true,\"last\":\"s\"}";
+    Json::ParseOptions options;
+    options.filter = paths;
+    Json::Value v = Json::parse(doc, options);
+    CHECK_STR(show(v), expect);
+    v.free_parsed();
+    char buf[400];
+    strcpy(buf, doc);
+    v = Json::parseInSitu(buf, strlen(buf), options);
+    CHECK_STR(show(v), expect);
+    v.free_parsed();
+    Json::aJsonStringStream in(doc);
+    CHECK(in.parseValue(&v, paths) == 0);
+    CHECK_STR(show(v), expect);
+    v.free_parsed();
+    const char *indices[] = { "[1]", "[0].a", NULL };
+    options.filter = indices;
+    v = Json::parse("[{\"a\":1,\"b\":2},[3,4],5]", options);
+    CHECK_STR(show(v), "[{\"a\":1},[3,4]]");
+    v.free_parsed();
+    const char *whole[] = { "meta", NULL };
+    options.filter = whole;
+    v = Json::parse(doc, options);
+    CHECK_STR(show(v), "{\"meta\":{\"id\":7,\"name\":\"x\"}}");
+    v.free_parsed();
+}
+
+TEST(stream_push) {
+    const char *doc = "{\"a\":[1,2.5,\"s\\\"t\\u0041\",true,null,{\"b\":{}}],\"c\":-3,\"a2\":[],\"c\":\"dup\"} [9]";
+    Json::PushParser parser;
+    int status = JSON_PUSH_NEED_MORE;
+    size_t offset = 0, length = strlen(doc);
+    // One byte at a time
+    while(offset < length && status == JSON_PUSH_NEED_MORE) {
+        status = parser.feed((const uint8_t *)doc + offset, 1);
+        offset += parser.consumed();
+    }
+    CHECK(status == JSON_PUSH_DONE);
+    Json::Value v = parser.take();
+    CHECK_STR(show(v), "{\"a\":[1,2.5,\"s\\\"tA\",true,null,{\"b\":{}}],\"c\":\"dup\",\"a2\":[]}");
+    v.free_parsed();
+    CHECK(parser.feed((const uint8_t *)doc + offset, length - offset) == JSON_PUSH_DONE);
+    v = parser.take();
+    CHECK_STR(show(v), "[9]");
+    v.free_parsed();
+    CHECK(parser.feed((const uint8_t *)"-12", 3) == JSON_PUSH_NEED_MORE);
+    CHECK(parser.feed((const uint8_t *)"5", 1) == JSON_PUSH_NEED_MORE);
+    CHECK(parser.finish() == JSON_PUSH_DONE);
+    CHECK_STR(show(parser.take()), "-125");
+    CHECK(parser.feed((const uint8_t *)"[1,{\"x\":tru}]", 13) == JSON_PUSH_ERROR);
+    parser.reset();
+    // Abandoned, and freed by the destructor
+    CHECK(parser.feed((const uint8_t *)"{\"k\":[1,[2", 10) == JSON_PUSH_NEED_MORE);
+}
+
+TEST(stream_path) {
+    Json::Path t("/s/[*]/t"), one("/s/1/t");
+    Json::Value found[4];
+    Json::aJsonStringStream in("{\"s\":[{\"t\":1},{\"t\":[2,\"two\"]},{\"u\":3}],\"a/b\":{\"m~n\":\"x\"}} {\"s\":[]}");
+    CHECK(in.parsePath(t, found, 1) == 2 && found[0].asInt() == 1);
+    found[0].free_parsed();
+    CHECK(in.parsePath(t, found, 4) == 0);
+    Json::aJsonStringStream in2("{\"s\":[{\"t\":1},{\"t\":[2,\"a long string value here\"]}]}");
+    CHECK(in2.parsePath(one, found, 4) == 1);
+    CHECK_STR(show(found[0]), "[2,\"a long string value here\"]");
+    found[0].free_parsed();
+    Json::aJsonStringStream broken("{\"s\":[{\"t\":\"a long string value here\"},");
+    CHECK(broken.parsePath(t, found, 4) == EOF);
+}
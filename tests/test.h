@@ -0,0 +1,58 @@
+// Minimal assertion harness for the host test build. Each TEST() registers
+// itself; json_tests runs them all, or those whose names start with its
+// argument, and exits non-zero if any CHECK failed.
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include "json.h"
+
+struct TestCase {
+    TestCase(const char *name, void (*run)());
+    const char *name;
+    void (*run)();
+    TestCase *next;
+};
+
+extern int test_failures;
+
+#define TEST(name) \
+    static void test_##name(); \
+    static TestCase case_##name(#name, test_##name); \
+    static void test_##name()
+
+#define CHECK(condition) do { \
+    if(!(condition)) { \
+        printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+        test_failures++; \
+    } \
+} while(0)
+
+#define CHECK_STR(actual, expected) do { \
+    const char *_actual = (actual), *_expected = (expected); \
+    if(!_actual || strcmp(_actual, _expected)) { \
+        printf("%s:%d: '%s' != '%s'\n", __FILE__, __LINE__, _actual ? _actual : "(null)", _expected); \
+        test_failures++; \
+    } \
+} while(0)
+
+// The value printed as JSON, valid until the next call
+const char *show(Json::Value value);
+
+// A Print that keeps raw bytes, for binary output such as CBOR
+class Bytes : public Print {
+public:
+    size_t write(uint8_t ch) { return write(&ch, 1); }
+    size_t write(const uint8_t *data, size_t length) {
+        if(length > sizeof(data_) - size)
+            length = sizeof(data_) - size;
+        memcpy(data_ + size, data, length);
+        size += length;
+        return length;
+    }
+    const uint8_t *data() { return data_; }
+    size_t size = 0;
+
+private:
+    uint8_t data_[1024];
+};
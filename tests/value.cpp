@@ -0,0 +1,107 @@
+#include "test.h"
+
+TEST(value_clone) {
+    Json::Value source = Json::parse("{\"a\":[1,\"two\",{\"b\":\"c\"}],\"s\":\"str\"}");
+    Json::Value copy(source.asObject().clone());
+    source.asObject()["a"].asArray()[2].asObject().set("b", Json::OwnedValue(Json::Value(5)));
+    CHECK_STR(show(copy), "{\"a\":[1,\"two\",{\"b\":\"c\"}],\"s\":\"str\"}");
+    source.free_parsed();
+    copy.free_parsed();
+    // Writing to the clone leaves its source alone
+    Json::Value tmpl = Json::parse("{\"body\":{\"kind\":\"a\"}}");
+    Json::Value c(tmpl.asObject().clone());
+    c.asObject()["body"].asObject()["kind"] = 5;
+    CHECK_STR(show(tmpl), "{\"body\":{\"kind\":\"a\"}}");
+    CHECK_STR(show(c), "{\"body\":{\"kind\":5}}");
+    tmpl.free_parsed();
+    c.free_parsed();
+}
+
+TEST(value_owned) {
+    Json::OwnedValue doc(Json::parse("{\"list\":[]}"));
+    Json::Array &list = doc->asObject()["list"].asArray();
+    list.append(Json::OwnedValue(Json::parse("{\"x\":\"y\"}")));
+    Json::OwnedValue item(Json::parse("[\"z\"]"));
+    CHECK(list.append(static_cast<Json::OwnedValue &&>(item)) && item->isNull());
+    doc->asObject().set("k", Json::OwnedValue(Json::Value("first")));
+    doc->asObject().set("k", Json::OwnedValue(Json::parse("[1,2]")));
+    CHECK_STR(show(*doc), "{\"list\":[{\"x\":\"y\"},[\"z\"]],\"k\":[1,2]}");
+    Json::OwnedValue moved(static_cast<Json::OwnedValue &&>(doc));
+    CHECK(doc->isNull() && moved->isObject());
+    doc = static_cast<Json::OwnedValue &&>(moved);
+    doc.reset(Json::parse("\"s\""));
+}
+
+TEST(value_inline_strings) {
+    Json::Value v = Json::parse("{\"s\":\"ok\",\"e\":\"\\u00e9x\",\"l\":\"longer string\",\"a\":[\"1234567\",\"12345678\"]}");
+    Json::Object &o = v.asObject();
+    CHECK((o["s"].flags & JSON_FLAG_INLINE) && !(o["l"].flags & JSON_FLAG_INLINE));
+    CHECK((o["a"].asArray()[0].flags & JSON_FLAG_INLINE) && !(o["a"].asArray()[1].flags & JSON_FLAG_INLINE));
+    CHECK_STR(o["e"].asString(), "\xc3\xa9x");
+    CHECK_STR(show(v), "{\"s\":\"ok\",\"e\":\"\xc3\xa9x\",\"l\":\"longer string\",\"a\":[\"1234567\",\"12345678\"]}");
+    v.free_parsed();
+    static const uint8_t cbor[] = { 0x62, 'h', 'i' };
+    Json::Value back = Json::parseCbor(cbor, sizeof(cbor));
+    CHECK_STR(back.asString(), "hi");
+}
+
+TEST(value_copy_on_write) {
+    Json::Value tmpl = Json::parse("{\"id\":0,\"body\":{\"kind\":\"status message\",\"tags\":[\"a\",\"b\"]},\"meta\":{\"v\":1}}");
+    Json::Value msg(tmpl.asObject().share());
+    Json::Object &m = msg.asObject();
+    m["id"] = 7;
+    CHECK(m["meta"].asObject().shares == 1);
+    m.edit("body")->asObject().edit("tags")->asArray().append(Json::Value("c"));
+    CHECK_STR(show(tmpl), "{\"id\":0,\"body\":{\"kind\":\"status message\",\"tags\":[\"a\",\"b\"]},\"meta\":{\"v\":1}}");
+    CHECK_STR(show(msg), "{\"id\":7,\"body\":{\"kind\":\"status message\",\"tags\":[\"a\",\"b\",\"c\"]},\"meta\":{\"v\":1}}");
+    CHECK(tmpl.asObject()["body"].asObject().shares == 0);
+    // The template side writing first also detaches
+    Json::Value msg2(tmpl.asObject().share());
+    tmpl.asObject().edit("meta")->asObject()["v"] = 2;
+    CHECK_STR(show(*msg2.asObject().get("meta")), "{\"v\":1}");
+    tmpl.free_parsed();
+    CHECK_STR(show(msg2), "{\"id\":0,\"body\":{\"kind\":\"status message\",\"tags\":[\"a\",\"b\"]},\"meta\":{\"v\":1}}");
+    msg.free_parsed();
+    msg2.free_parsed();
+    // A copy of a member value is not its slot: nothing is detached
+    // through it, and edit() misses what is not there
+    Json::Value root = Json::parse("{\"n\":{\"a\":1},\"l\":[[0]]}");
+    Json::Value c(root.asObject().share());
+    Json::Value n = c.asObject()["n"];
+    CHECK(n.asObject().shares == 1 && root.asObject().get("n")->asObject().shares == 1);
+    CHECK(!c.asObject().edit("missing") && !c.asObject().edit("l")->asArray().edit(1));
+    c.asObject().edit("l")->asArray().edit(0)->asArray().append(Json::Value(1));
+    CHECK_STR(show(c), "{\"n\":{\"a\":1},\"l\":[[0,1]]}");
+    CHECK_STR(show(root), "{\"n\":{\"a\":1},\"l\":[[0]]}");
+    root.free_parsed();
+    c.free_parsed();
+    // Arena containers are copied, not shared
+    Json::Arena arena;
+    Json::ParseOptions options;
+    options.arena = &arena;
+    Json::Value a = Json::parse("[[1,\"long string here\"]]", options);
+    Json::Value copy(a.asArray().share());
+    arena.reset();
+    CHECK_STR(show(copy), "[[1,\"long string here\"]]");
+    copy.free_parsed();
+}
+
+TEST(value_path) {
+    Json::Value v = Json::parse("{\"s\":[{\"t\":1},{\"t\":2.5},{\"u\":3}],\"a/b\":{\"m~n\":\"x\"},\"0\":\"zero\"}");
+    Json::Path t("/s/[*]/t"), escaped("/a~1b/m~0n"), one("/s/1/t"), zero("/0"), whole(""), missing("/s/9/t");
+    CHECK(t.valid() && escaped.valid());
+    CHECK(!Json::Path("s/t").valid() && !Json::Path("/a~2").valid());
+    Json::Value found[4];
+    CHECK(t.find(v, found, 4) == 2 && found[0].asInt() == 1 && found[1].asDouble() == 2.5);
+    Json::Value x = escaped.get(v);
+    CHECK_STR(x.asString(), "x");
+    CHECK(one.get(v).asDouble() == 2.5 && missing.get(v).isInvalid());
+    Json::Value z = zero.get(v);
+    CHECK_STR(z.asString(), "zero");
+    CHECK_STR(show(Json::Path("/a~1b").get(v)), "{\"m~n\":\"x\"}");
+    // Reading a missing key adds nothing
+    int before = v.asObject().size();
+    Json::Path("/nope/x").get(v);
+    CHECK(v.asObject().size() == before && whole.get(v).isObject());
+    v.free_parsed();
+}
@@ -0,0 +1,165 @@
+#include "json.h"
+#include "scan.h"
+
+using namespace Json;
+
+// What nextToken() expects to read next.
+#define STATE_VALUE 0       // a value; where every document starts
+#define STATE_FIRST_VALUE 1 // a value or ']' straight after '['
+#define STATE_KEY 2         // a key after ','
+#define STATE_FIRST_KEY 3   // a key or '}' straight after '{'
+#define STATE_COLON 4       // the ':' after a key
+#define STATE_NEXT 5        // ',' or the end of the enclosing container
+#define STATE_STRING 6      // the rest of a string value
+#define STATE_KEY_STRING 7  // the rest of a key
+
+static int fail(Token *token, uint8_t *state, uint8_t *depth)
+{
+    *state = STATE_VALUE;
+    *depth = 0;
+    return token->type = JSON_TOKEN_ERROR;
+}
+
+int aJsonStream::nextToken(Token *token)
+{
+    token->length = 0;
+    token->chunk[0] = 0;
+    token->more = false;
+    if (token_state == STATE_STRING || token_state == STATE_KEY_STRING)
+        return this->readChunk(token);
+    // A complete top level value; do not wait on the stream for more
+    if (token_state == STATE_NEXT && token_depth == 0)
+    {
+        token_state = STATE_VALUE;
+        return token->type = JSON_TOKEN_END;
+    }
+    for (;;)
+    {
+        if (this->skip() == EOF)
+            return fail(token, &token_state, &token_depth);
+        int in = this->getch();
+        switch (token_state)
+        {
+        case STATE_FIRST_KEY:
+            if (in == '}')
+                return this->closeContainer(in, token);
+            // fall through
+        case STATE_KEY:
+            if (in != '\"')
+                return fail(token, &token_state, &token_depth);
+            token_state = STATE_KEY_STRING;
+            return this->readChunk(token);
+        case STATE_COLON:
+            if (in != ':')
+                return fail(token, &token_state, &token_depth);
+            token_state = STATE_VALUE;
+            continue;
+        case STATE_NEXT:
+            if (in == ',')
+            {
+                bool object = token_stack[(token_depth - 1) / 8] & (1 << ((token_depth - 1) % 8));
+                token_state = object ? STATE_KEY : STATE_VALUE;
+                continue;
+            }
+            return this->closeContainer(in, token);
+        case STATE_FIRST_VALUE:
+            if (in == ']')
+                return this->closeContainer(in, token);
+            // fall through
+        default:
+            break;
+        }
+
+        // The start of a value
+        if (in == '{' || in == '[')
+        {
+            if (token_depth == JSON_TOKEN_MAX_DEPTH)
+                return fail(token, &token_state, &token_depth);
+            uint8_t bit = 1 << (token_depth % 8);
+            if (in == '{')
+                token_stack[token_depth / 8] |= bit;
+            else
+                token_stack[token_depth / 8] &= ~bit;
+            token_depth++;
+            token_state = in == '{' ? STATE_FIRST_KEY : STATE_FIRST_VALUE;
+            return token->type = in == '{' ? JSON_TOKEN_START_OBJECT : JSON_TOKEN_START_ARRAY;
+        }
+        if (in == '\"')
+        {
+            token_state = STATE_STRING;
+            return this->readChunk(token);
+        }
+        this->ungetch(in);
+        token_state = STATE_NEXT;
+        if (in == '-' || (in >= '0' && in <= '9'))
+        {
+            if (this->parseNumber(&token->value))
+                return fail(token, &token_state, &token_depth);
+            return token->type = JSON_TOKEN_NUMBER;
+        }
+        // Only true, false or null are left, none of which allocate
+        if (this->parseValue(&token->value, NULL))
+            return fail(token, &token_state, &token_depth);
+        return token->type = token->value.isBool() ? JSON_TOKEN_BOOLEAN : JSON_TOKEN_NULL;
+    }
+}
+
+int aJsonStream::closeContainer(int in, Token *token)
+{
+    if (token_depth == 0)
+        return fail(token, &token_state, &token_depth);
+    bool object = token_stack[(token_depth - 1) / 8] & (1 << ((token_depth - 1) % 8));
+    if (in != (object ? '}' : ']'))
+        return fail(token, &token_state, &token_depth);
+    token_depth--;
+    token_state = STATE_NEXT;
+    return token->type = object ? JSON_TOKEN_END_OBJECT : JSON_TOKEN_END_ARRAY;
+}
+
+// Read up to a chunk of the current key or string.
+int aJsonStream::readChunk(Token *token)
+{
+    bool key = token_state == STATE_KEY_STRING;
+    token->type = key ? JSON_TOKEN_KEY : JSON_TOKEN_STRING;
+    for (;;)
+    {
+        int in = this->getch();
+        if (in == EOF)
+            return fail(token, &token_state, &token_depth);
+        if (in == '\"')
+        {
+            token_state = key ? STATE_COLON : STATE_NEXT;
+            break;
+        }
+        // Full; end the chunk here unless the string ends here too
+        if (token->length == JSON_TOKEN_CHUNK_LEN)
+        {
+            this->ungetch(in);
+            token->more = true;
+            break;
+        }
+        if (in == '\\')
+        {
+            // An escape decodes to several bytes; leave it for the next
+            // chunk unless they all fit in this one
+            if (JSON_TOKEN_CHUNK_LEN - token->length < JSON_ESCAPE_MAX_BYTES)
+            {
+                this->ungetch(in);
+                token->more = true;
+                break;
+            }
+            int length = this->readEscape(this->getch(), token->chunk + token->length);
+            if (length == EOF)
+                return fail(token, &token_state, &token_depth);
+            token->length += length;
+            continue;
+        }
+        else if (in < 32 && in >= 0)
+        {
+            return fail(token, &token_state, &token_depth);
+        }
+        token->chunk[token->length++] = in;
+    }
+    token->chunk[token->length] = 0;
+    return token->type;
+}
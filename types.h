@@ -10,32 +10,83 @@
 #define JSON_STRING 4
 #define JSON_ARRAY 5
 #define JSON_OBJECT 6
+#define JSON_LAZY 7 // an unparsed container or member value of a LazyDocument
 #define JSON_INVALID 255
 
+//Storage for integer values; numbers outside its range parse as doubles.
+//AVR keeps long so the value union stays the size of its 4 byte double.
+#ifndef JSON_INT_TYPE
+#ifdef __AVR__
+#define JSON_INT_TYPE long
+#else
+#define JSON_INT_TYPE int64_t
+#endif
+#endif
+typedef JSON_INT_TYPE json_int_t;
+
+//Value flags
+#define JSON_FLAG_BORROWED 0x01 // storage is owned by an Arena or the input buffer, free_parsed leaves it alone
+#define JSON_FLAG_INLINE 0x02   // a short string stored in the value itself
+
+//Strings shorter than this are kept inline instead of allocated: the size
+//of the value union, 8 bytes, or 4 on AVR
+#define JSON_INLINE_SIZE (sizeof(json_int_t) > sizeof(double) ? sizeof(json_int_t) : sizeof(double))
+
 namespace Json {
 
     class Value;
+    class OwnedValue;
+    struct LazyNode;
 
     class Object : public AMap<Value> {
     public:
         Object(Object &source) : AMap<Value>(source) { };
-        Object() { };
+        Object(Arena *arena = NULL) : AMap<Value>(arena) { };
+        // A deep copy
         Object* clone();
+        // A copy of this level whose nested containers are shared with
+        // the source until either side reaches them through edit(). Write
+        // below the top level only through edit(), on either side
+        Object* share();
         ~Object();
+        using AMap<Value>::set;
+        // Store value under key, freeing the value it replaces. Returns
+        // false if it could not be stored, leaving value with the caller
+        bool set(const char *key, OwnedValue &&value);
+        bool set(const Key &key, OwnedValue &&value);
+        // The member under key for writing to: a container it shares with
+        // a share() is first replaced in this object by a copy of its own.
+        // NULL if there is no such member or memory ran out
+        Value *edit(const char *key);
+        //Other values holding this container since a share(); while this
+        //is nonzero, edit() on a parent holding it stores a copy first
+        uint16_t shares = 0;
     protected:
         virtual Value default_init();
+        virtual void free_value(Value &value);
     private:
         Object(const Object&);
+        Object *duplicate(bool share);
     };
     
     class Array : public AList<Value> {
     public:
         Array(Array &source) : AList<Value>(source) { };
-        Array() { };
+        Array(Arena *arena = NULL) : AList<Value>(arena) { };
+        // As Object::clone and Object::share
         Array* clone();
+        Array* share();
         ~Array();
+        using AList<Value>::append;
+        // Take value over; on failure it stays with the caller
+        bool append(OwnedValue &&value);
+        // Element i for writing to, as Object::edit
+        Value *edit(int i);
+        //As Object::shares
+        uint16_t shares = 0;
     private:
         Array(const Array&);
+        Array *duplicate(bool share);
     };
 
     class Value {
@@ -43,21 +94,50 @@ namespace Json {
         Value(bool b) { type = JSON_BOOLEAN; valuebool = b; }
         Value(int i) { type = JSON_INT; valueint = i; }
         Value(uint i) { type = JSON_INT; valueint = i; }
+        Value(long i) { type = JSON_INT; valueint = i; }
+        Value(unsigned long i) { type = JSON_INT; valueint = i; }
+        Value(long long i) { type = JSON_INT; valueint = i; }
+        Value(unsigned long long i) { type = JSON_INT; valueint = i; }
         Value(float i) { type = JSON_FLOAT; valuefloat = i; }
+        Value(double i) { type = JSON_FLOAT; valuefloat = i; }
         Value(const char *s) : Value((char*)s) { }
         Value(char *s) {
             type = JSON_STRING;
-            char * buf = (char *)malloc(strlen(s) + 1);
-#ifdef SMALLOC_DEBUG
-            Serial.print("String malloc: ");
-            Serial.println(int(buf));
-#endif
+            if(storeInline(s, strlen(s)))
+                return;
+            char * buf = (char *)heapAlloc(strlen(s) + 1);
+            if(buf == NULL) {
+                type = JSON_INVALID;
+                return;
+            }
             memcpy(buf, s, strlen(s) + 1);
             valuestring = buf;
         }
+        // Copies s into arena, or onto the heap if arena is NULL
+        Value(const char *s, size_t length, Arena *arena) {
+            type = JSON_STRING;
+            if(storeInline(s, length))
+                return;
+            char *buf = (char *)allocate(arena, length + 1);
+            if(buf == NULL) {
+                type = JSON_INVALID;
+                return;
+            }
+            memcpy(buf, s, length);
+            buf[length] = 0;
+            valuestring = buf;
+            if(arena)
+                flags |= JSON_FLAG_BORROWED;
+        }
         Value(String s) {
             type = JSON_STRING;
-            char * buf = (char *)malloc(s.length() + 1);
+            if(storeInline(s.c_str(), s.length()))
+                return;
+            char * buf = (char *)heapAlloc(s.length() + 1);
+            if(buf == NULL) {
+                type = JSON_INVALID;
+                return;
+            }
             buf[s.length()] = 0;
             s.toCharArray(buf, s.length() + 1);
             valuestring = buf;
@@ -66,57 +146,153 @@ namespace Json {
         Value(Array *a) { type = JSON_ARRAY; valuearray = a; }
         Value(Object &o) : Value(&o) { }
         Value(Object *o) { type = JSON_OBJECT; valueobject = o; }
+        Value(LazyNode *node) { type = JSON_LAZY; valuelazy = node; }
         Value() { type = JSON_NULL; }
-        bool isBool() { return type == JSON_BOOLEAN; }
-        int asBool() { return type == JSON_BOOLEAN ? valuebool : 0; }
-        bool isFloat() { return type == JSON_FLOAT; }
-        float asFloat() { return type == JSON_FLOAT ? valuefloat : 0.0f; }
-        bool isDouble() { return type == JSON_FLOAT; }
-        float asDouble() { return type == JSON_FLOAT ? valuefloat : 0.0; }
-        bool isInt() { return type == JSON_INT; }
-        int asInt() { return type == JSON_INT ? valueint : 0; }
-        bool isString() { return type == JSON_STRING; }
-        const char* asString() { return type == JSON_STRING ? valuestring : NULL; }
-        bool isObject() { return type == JSON_OBJECT; }
-        Object &asObject() { return *valueobject; }
-        bool isArray() { return type == JSON_ARRAY; }
-        Array &asArray() { return *valuearray; }
-        bool isNull() { return type == JSON_NULL; }
+        // Reading a lazy member value parses it first; a lazy container
+        // stays lazy
+        bool isBool() { materializeScalar(); return type == JSON_BOOLEAN; }
+        int asBool() { materializeScalar(); return type == JSON_BOOLEAN ? valuebool : 0; }
+        bool isFloat() { materializeScalar(); return type == JSON_FLOAT; }
+        float asFloat() { materializeScalar(); return type == JSON_FLOAT ? valuefloat : 0.0f; }
+        bool isDouble() { materializeScalar(); return type == JSON_FLOAT; }
+        double asDouble() { materializeScalar(); return type == JSON_FLOAT ? valuefloat : 0.0; }
+        bool isInt() { materializeScalar(); return type == JSON_INT; }
+        int asInt() { materializeScalar(); return type == JSON_INT ? valueint : 0; }
+        // Full json_int_t width, where asInt() truncates to int
+        json_int_t asInt64() { materializeScalar(); return type == JSON_INT ? valueint : 0; }
+        bool isString() { materializeScalar(); return type == JSON_STRING; }
+        // A short string lives inside the value, so this points into it:
+        // only good while this value, not a copy, is alive and unmoved
+        const char* asString() {
+            materializeScalar();
+            if(type != JSON_STRING)
+                return NULL;
+            return flags & JSON_FLAG_INLINE ? valueinline : valuestring;
+        }
+        bool isObject() { return type == JSON_OBJECT || (type == JSON_LAZY && lazyType() == JSON_OBJECT); }
+        // A container nested in a share() may be shared with its source:
+        // reach it through Object::edit() or Array::edit() to write to it
+        Object &asObject() { materialize(); return *valueobject; }
+        bool isArray() { return type == JSON_ARRAY || (type == JSON_LAZY && lazyType() == JSON_ARRAY); }
+        Array &asArray() { materialize(); return *valuearray; }
+        // Parse a lazy value in place; it is shared with its document
+        void materialize() { if(type == JSON_LAZY) materializeLazy(); }
+        // The text of a lazy value, NULL once it has been parsed
+        const char *lazyText(size_t *length);
+        bool isNull() { materializeScalar(); return type == JSON_NULL; }
         bool isInvalid() { return type == JSON_INVALID; }
         static Value invalid() {
             Value output;
             output.type = JSON_INVALID;
             return output;
         }
+        // References s without copying it, so s must outlive the value
+        static Value borrowed(const char *s) {
+            Value output;
+            output.type = JSON_STRING;
+            output.valuestring = s;
+            output.flags |= JSON_FLAG_BORROWED;
+            return output;
+        }
+        // Takes ownership of s, which must have come from malloc, or from
+        // the alloc hook if JSON_STATS hooks are installed
+        static Value adopted(char *s) {
+            Value output;
+            output.type = JSON_STRING;
+            output.valuestring = s;
+            return output;
+        }
         void free_parsed() {
+            if(flags & (JSON_FLAG_BORROWED | JSON_FLAG_INLINE))
+                return;
             switch(type) {
                 case JSON_STRING:
-#ifdef SMALLOC_DEBUG
-                    Serial.print("String free: ");
-                    Serial.println(int(valuestring));
-#endif
-                    delete (char*)valuestring;
+                    heapFree((char*)valuestring, strlen(valuestring) + 1);
                     break;
                 case JSON_ARRAY:
-                    delete valuearray;
+                    if(valuearray->shares)
+                        valuearray->shares--;
+                    else
+                        delete valuearray;
                     break;
                 case JSON_OBJECT:
-                    delete valueobject;
+                    if(valueobject->shares)
+                        valueobject->shares--;
+                    else
+                        delete valueobject;
                     break;
                 default:
                     break;
             }
         }
-        char type;
+        unsigned char type; // unsigned so JSON_INVALID compares equal
+        unsigned char flags = 0;
     private:
         union {
             double valuefloat;     // used for double and float
-            int valueint;    // used for bool, char, short, int and longs
+            json_int_t valueint;    // used for char, short, int and longs
             const char* valuestring;  // asString can be null
             bool valuebool;
             Object *valueobject;    // asArray cannot be null
             Array *valuearray;
+            LazyNode *valuelazy;
+            char valueinline[JSON_INLINE_SIZE];
         };
         Value(char type) { this->type = type; }
+        bool storeInline(const char *s, size_t length) {
+            if(length >= JSON_INLINE_SIZE)
+                return false;
+            memcpy(valueinline, s, length);
+            valueinline[length] = 0;
+            flags |= JSON_FLAG_INLINE;
+            return true;
+        }
+        int lazyType();
+        void materializeLazy();
+        // Parse a lazy member value, leaving a lazy container alone
+        void materializeScalar() { if(type == JSON_LAZY && lazyType() == JSON_INVALID) materializeLazy(); }
+    };
+
+    /* Owns a parsed value and frees it when it goes out of scope. It can
+     * be moved but not copied, and moving one into a container with
+     * Array::append or Object::set hands the value over without a copy:
+     *
+     *   Json::OwnedValue doc(Json::parse(text));
+     *   doc->asArray().append(Json::OwnedValue(Json::parse(line)));
+     *
+     * The Value inside is the same value type used everywhere else, so
+     * get() and operator-> reach it without transferring ownership. */
+    class OwnedValue {
+    public:
+        OwnedValue() { }
+        explicit OwnedValue(Value value) : value(value) { }
+        OwnedValue(OwnedValue &&other) : value(other.release()) { }
+        OwnedValue &operator=(OwnedValue &&other) {
+            if(this != &other)
+                reset(other.release());
+            return *this;
+        }
+        ~OwnedValue() { value.free_parsed(); }
+
+        Value &get() { return value; }
+        Value &operator*() { return value; }
+        Value *operator->() { return &value; }
+        // Give up ownership, leaving null behind
+        Value release() {
+            Value output = value;
+            value = Value();
+            return output;
+        }
+        // Free the current value and own replacement instead
+        void reset(Value replacement = Value()) {
+            value.free_parsed();
+            value = replacement;
+        }
+
+    private:
+        OwnedValue(const OwnedValue &);
+        OwnedValue &operator=(const OwnedValue &);
+
+        Value value;
     };
-}
\ No newline at end of file
+}
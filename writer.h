@@ -0,0 +1,57 @@
+#pragma once
+
+#include "json.h"
+
+namespace Json {
+  /* Collects encoder output in a chunk on the stack and hands it to the
+   * Print with one bulk write per chunk, instead of a virtual call per
+   * byte. Returns from the Print are summed into written. */
+  class Writer {
+  public:
+    Writer(Print &print) : written(0), print(print), used(0) {}
+    ~Writer() { flush(); }
+
+    void put(char ch) {
+      if(used == sizeof(buffer))
+        flush();
+      buffer[used++] = ch;
+    }
+    void put(const char *str, size_t length) {
+      if(length > sizeof(buffer) - used) {
+        flush();
+        // Too long to be worth copying twice
+        if(length >= sizeof(buffer)) {
+          written += print.write((const uint8_t *)str, length);
+          return;
+        }
+      }
+      memcpy(buffer + used, str, length);
+      used += length;
+    }
+    // Room for length bytes, to be claimed with commit()
+    char *reserve(size_t length) {
+      if(length > sizeof(buffer) - used)
+        flush();
+      return buffer + used;
+    }
+    void commit(char *end) { used = end - buffer; }
+    void flush() {
+      if(used)
+        written += print.write((const uint8_t *)buffer, used);
+      used = 0;
+    }
+
+    size_t written;
+
+  private:
+    Print &print;
+    size_t used;
+    char buffer[PRINT_BUFFER_LEN];
+  };
+
+  /* The encoder's scalar output, for code that writes JSON without
+   * building a Value. */
+  void printInt(json_int_t i, Writer &out);
+  void printFloat(double d, Writer &out);
+  void printStringPtr(const char *str, Writer &out);
+}